@@ -0,0 +1,275 @@
+// bench.cpp
+
+
+#include "bench.h"
+#include "worldconfig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#ifdef LINUX
+  #include <sched.h>
+#endif
+
+using namespace std;
+
+
+static double benchClock()
+
+{
+  return chrono::duration<double>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+// Sort the samples and compute the summary statistics
+
+void BenchResult::summarise()
+
+{
+  vector<double> s = ns;
+  sort( s.begin(), s.end() );
+
+  int n = s.size();
+
+  double sum = 0;
+  for (int i=0; i<n; i++)
+    sum += s[i];
+  mean = sum / n;
+
+  double var = 0;
+  for (int i=0; i<n; i++)
+    var += (s[i] - mean) * (s[i] - mean);
+  stddev = (n > 1 ? sqrt( var / (n-1) ) : 0);
+
+  min    = s[0];
+  max    = s[n-1];
+  median = (n % 2 ? s[n/2] : 0.5 * (s[n/2-1] + s[n/2]));
+  p90    = s[ std::min( n-1, (int) (0.9 * n) ) ];
+}
+
+
+Bench::Bench( const char *suiteName )
+
+{
+  suite = suiteName;
+  reps = 20;
+  warmup = 3;
+  minRepSeconds = 0.005;
+  cpu = -2; // the CPU we start on
+  lastRun = NULL;
+}
+
+
+void Bench::setDefaults( int r, int w, double minRepMs )
+
+{
+  reps = r;
+  warmup = w;
+  minRepSeconds = minRepMs / 1000.0;
+}
+
+
+bool Bench::parseArgs( int argc, char **argv )
+
+{
+  for (int i=1; i<argc; i++)
+    if (strcmp( argv[i], "-json" ) == 0 && i+1 < argc)
+      jsonFile = argv[++i];
+    else if (strcmp( argv[i], "-filter" ) == 0 && i+1 < argc)
+      filter = argv[++i];
+    else if (strcmp( argv[i], "-reps" ) == 0 && i+1 < argc)
+      reps = std::max( 1, atoi( argv[++i] ) );
+    else if (strcmp( argv[i], "-warmup" ) == 0 && i+1 < argc)
+      warmup = std::max( 0, atoi( argv[++i] ) );
+    else if (strcmp( argv[i], "-mintime" ) == 0 && i+1 < argc)
+      minRepSeconds = atof( argv[++i] ) / 1000.0;
+    else if (strcmp( argv[i], "-cpu" ) == 0 && i+1 < argc)
+      cpu = atoi( argv[++i] );
+    else if (strcmp( argv[i], "-config" ) == 0 && i+1 < argc) {
+      if (!worldConfig.load( argv[++i] ))
+        return false;
+    }
+    else if (strcmp( argv[i], "-set" ) == 0 && i+1 < argc) {
+      if (!worldConfig.set( argv[++i] ))
+        return false;
+    }
+    else {
+      cerr << "Usage: " << argv[0]
+           << " [-json file] [-filter str] [-reps n] [-warmup n] [-mintime ms] [-cpu n]"
+           << " [-config file] [-set name=value]" << endl;
+      return false;
+    }
+
+  if (!worldConfig.validate())
+    return false;
+
+  pin();
+
+  printf( "%-52s %12s %12s %12s %9s\n", suite.c_str(), "min ns/op", "median", "p90", "rsd" );
+
+  return true;
+}
+
+
+// Pin this thread to one CPU
+
+void Bench::pin()
+
+{
+  if (cpu == -1)
+    return;
+
+#ifdef LINUX
+  if (cpu == -2)
+    cpu = sched_getcpu();
+
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  CPU_SET( cpu, &set );
+
+  if (sched_setaffinity( 0, sizeof(set), &set ) != 0) {
+    cerr << "Could not pin to CPU " << cpu << ": running unpinned" << endl;
+    cpu = -1;
+  }
+#else
+  cerr << "CPU pinning is not supported on this platform: running unpinned" << endl;
+  cpu = -1;
+#endif
+}
+
+
+void Bench::run( const char *name, vector<BenchParam> params, long opsPerIteration,
+                 function<void(long iterations)> run,
+                 function<void()> setup )
+
+{
+  lastRun = NULL;
+
+  if (!filter.empty() && strstr( name, filter.c_str() ) == NULL)
+    return;
+
+  BenchResult r;
+  r.name = name;
+  r.params = params;
+  r.opsPerIteration = opsPerIteration;
+
+  // Calibrate: double the iteration count until one repetition takes
+  // at least 'minRepSeconds'.  This also warms the caches.
+
+  long iterations = 1;
+
+  while (true) {
+    if (setup)
+      setup();
+
+    double start = benchClock();
+    run( iterations );
+    double t = benchClock() - start;
+
+    if (t >= minRepSeconds || iterations >= (1L << 30))
+      break;
+
+    iterations = (t < minRepSeconds / 100 ? iterations * 10 : iterations * 2);
+  }
+
+  r.iterations = iterations;
+
+  for (int i=0; i<warmup+reps; i++) {
+
+    if (setup)
+      setup();
+
+    double start = benchClock();
+    run( iterations );
+    double t = benchClock() - start;
+
+    if (i >= warmup)
+      r.ns.push_back( 1e9 * t / ((double) iterations * opsPerIteration) );
+  }
+
+  r.summarise();
+
+  // Show progress as we go, since a whole suite can take a while
+
+  string label = name;
+  for (unsigned int i=0; i<params.size(); i++) {
+    char buf[64];
+    sprintf( buf, " %s=%g", params[i].name.c_str(), params[i].value );
+    label += buf;
+  }
+
+  printf( "%-52s %12.2f %12.2f %12.2f %8.1f%%\n",
+          label.c_str(), r.min, r.median, r.p90, 100 * r.stddev / r.mean );
+  fflush( stdout );
+
+  results.push_back( r );
+  lastRun = &results.back();
+}
+
+
+void Bench::note( const char *name, double value )
+
+{
+  if (lastRun) {
+    BenchParam p = { name, value };
+    lastRun->metrics.push_back( p );
+  }
+}
+
+
+// Write the JSON file, if one was requested
+
+bool Bench::finish()
+
+{
+  if (jsonFile.empty())
+    return true;
+
+  FILE *f = fopen( jsonFile.c_str(), "w" );
+
+  if (f == NULL) {
+    cerr << "Could not open benchmark output file " << jsonFile << endl;
+    return false;
+  }
+
+  fprintf( f, "{\n  \"suite\": \"%s\",\n  \"time\": %ld,\n  \"cpu\": %d,\n  \"reps\": %d,\n  \"warmup\": %d,\n  \"results\": [\n",
+           suite.c_str(), (long) time(NULL), cpu, reps, warmup );
+
+  for (unsigned int i=0; i<results.size(); i++) {
+
+    BenchResult &r = results[i];
+
+    fprintf( f, "    { \"name\": \"%s\", \"params\": {", r.name.c_str() );
+    for (unsigned int j=0; j<r.params.size(); j++)
+      fprintf( f, "%s\"%s\": %g", (j ? ", " : " "), r.params[j].name.c_str(), r.params[j].value );
+    fprintf( f, "%s},\n", (r.params.size() ? " " : "") );
+
+    fprintf( f, "      \"iterations\": %ld, \"ops_per_iteration\": %ld,\n", r.iterations, r.opsPerIteration );
+    fprintf( f, "      \"ns_per_op\": { \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"p90\": %.3f, \"max\": %.3f },\n",
+             r.min, r.median, r.mean, r.stddev, r.p90, r.max );
+
+    if (r.metrics.size()) {
+      fprintf( f, "      \"metrics\": {" );
+      for (unsigned int j=0; j<r.metrics.size(); j++)
+        fprintf( f, "%s\"%s\": %g", (j ? ", " : " "), r.metrics[j].name.c_str(), r.metrics[j].value );
+      fprintf( f, " },\n" );
+    }
+
+    fprintf( f, "      \"samples\": [" );
+    for (unsigned int j=0; j<r.ns.size(); j++)
+      fprintf( f, "%s%.3f", (j ? ", " : ""), r.ns[j] );
+    fprintf( f, "] }%s\n", (i+1 < results.size() ? "," : "") );
+  }
+
+  fprintf( f, "  ]\n}\n" );
+  fclose( f );
+
+  cout << "Results written to " << jsonFile << endl;
+  return true;
+}
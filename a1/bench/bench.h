@@ -0,0 +1,116 @@
+// bench.h
+//
+// A small harness for the benchmarks in this directory.
+//
+// Each benchmark is a function that runs its operation 'iterations'
+// times, with an optional set-up function that is called (untimed)
+// before every repetition to restore the starting state.  The harness
+// calibrates the iteration count so that a repetition takes at least
+// a few milliseconds, runs some warm-up repetitions, then times the
+// rest and reports the distribution of the time per operation.
+//
+// The process is pinned to one CPU (on Linux) so that the numbers
+// aren't disturbed by migration between cores.  Results are printed
+// as a table and, with -json, written as JSON for comparison between
+// runs.
+//
+// Command-line options (parsed by Bench::parseArgs):
+//
+//   -json file      write the results to 'file'
+//   -filter str     run only the benchmarks whose names contain 'str'
+//   -reps n         timed repetitions per benchmark (default 20)
+//   -warmup n       untimed repetitions per benchmark (default 3)
+//   -mintime ms     minimum time per repetition (default 5)
+//   -cpu n          CPU to pin to (default: the current one; -1 = don't pin)
+//   -config file    read world settings from 'file' (see worldconfig.h)
+//   -set name=value change one world setting
+
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <functional>
+#include <vector>
+
+
+// Keep the compiler from optimising away a value or the stores that
+// produced it.
+
+template<class T> inline void benchKeep( T const &x )
+
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile( "" : : "g"(&x) : "memory" );
+#else
+  static volatile const void *sink;
+  sink = &x;
+#endif
+}
+
+
+struct BenchParam {
+  std::string name;
+  double value;
+};
+
+
+struct BenchResult {
+
+  std::string name;
+  std::vector<BenchParam> params;
+
+  long iterations;         // calls per repetition
+  long opsPerIteration;
+  std::vector<double> ns;  // time per operation in each repetition
+
+  double min, median, mean, stddev, p90, max;
+
+  std::vector<BenchParam> metrics; // other measurements, added with Bench::note()
+
+  void summarise();
+};
+
+
+class Bench {
+
+  std::string suite;
+  std::string jsonFile;
+  std::string filter;
+
+  int reps;
+  int warmup;
+  double minRepSeconds;
+  int cpu;
+
+  std::vector<BenchResult> results;
+  BenchResult *lastRun;
+
+ public:
+
+  Bench( const char *suiteName );
+
+  void setDefaults( int reps, int warmup, double minRepMs ); // before parseArgs()
+  bool parseArgs( int argc, char **argv );
+  void pin();
+
+  // Run one benchmark.  'params' describes the configuration (e.g.
+  // the number of segments) and is copied to the output.  'run' does
+  // 'opsPerIteration' operations 'iterations' times; times are
+  // reported per operation.
+
+  void run( const char *name, std::vector<BenchParam> params, long opsPerIteration,
+            std::function<void(long iterations)> run,
+            std::function<void()> setup = std::function<void()>() );
+
+  // The most recent result, and a way to attach more measurements to
+  // it (e.g. memory use).  last() is NULL if the last benchmark was
+  // filtered out.
+
+  BenchResult *last() { return lastRun; }
+  void note( const char *name, double value );
+
+  bool finish(); // write the JSON file
+};
+
+#endif
@@ -0,0 +1,526 @@
+// microbench.cpp
+//
+// Micro-benchmarks of the simulation kernels and the containers and
+// maths that they use.  Build and run with "make bench" in ../linux.
+//
+// These link the game's own objects (everything but main.o), so they
+// measure the code that the game runs.  No window or GL context is
+// created; nothing here draws.
+
+
+#include "headers.h"
+#include "world.h"
+#include "bench.h"
+#include "segmentsweep.h"
+
+
+// Globals that the game's objects expect main.cpp to define
+
+GLFWwindow *window = NULL;
+GPUProgram *gpuProg = NULL;
+World *world = NULL;
+bool pauseGame = false;
+float speedMultiplier = 1.0;
+
+
+#define TICK_TIME (1.0 / SIM_TICKS_PER_SECOND)
+
+
+// A random position on the mushroom grid (as in World::initWorld)
+
+static vec2 randomGridPos()
+
+{
+  int numCols = worldConfig.numCols();
+
+  int r = rand() % worldConfig.numRows;
+  int c = rand() % numCols;
+
+  return vec2( WORLD_LEFT_EDGE + (c + 1) * worldConfig.colSpacing, WORLD_TOP_ROW - r * worldConfig.rowSpacing );
+}
+
+
+// A random position anywhere in the playing field
+
+static vec2 randomFieldPos()
+
+{
+  return vec2( WORLD_LEFT_EDGE + randIn01() * (WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE),
+               WORLD_BOTTOM_ROW + randIn01() * (WORLD_TOP_ROW - WORLD_BOTTOM_ROW) );
+}
+
+
+// World::findClosestMushroomAhead, as called by the centipede heads
+// (horizontally) and by the darts (vertically)
+
+static void benchFindClosestMushroom( Bench &bench )
+
+{
+  const int numMushroomCounts = 4;
+  int mushroomCounts[numMushroomCounts] = { 60, 1000, 10000, 100000 };
+
+  const int numQueries = 256;
+  vec2 queryPos[numQueries];
+  vec2 queryDir[numQueries];
+
+  srand( 1 );
+  for (int i=0; i<numQueries; i++) {
+    queryPos[i] = randomFieldPos();
+    queryDir[i] = (i % 4 == 0 ? vec2( 0, 1 ) : (i % 2 ? vec2( 1, 0 ) : vec2( -1, 0 )));
+  }
+
+  for (int m=0; m<numMushroomCounts; m++) {
+
+    world->clearEntities();
+    for (int i=0; i<mushroomCounts[m]; i++)
+      world->addMushroom( randomGridPos() ); // duplicates are fine here
+
+    bench.run( "findClosestMushroomAhead", { { "mushrooms", (double) mushroomCounts[m] } }, 1,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   MushroomHandle m = world->findClosestMushroomAhead( queryPos[i % numQueries], queryDir[i % numQueries], worldConfig.rowSpacing / 4 );
+                   benchKeep( m );
+                 }
+               } );
+  }
+}
+
+
+// The same queries on the two instantiations of MushroomGrid: the
+// StandardGrid, with its dimensions known at compile time, and the
+// RuntimeGrid, with the same dimensions read from the world config.
+// (Only meaningful with the default grid, where both are the same.)
+
+template <class Grid>
+static void benchGridQuery( Bench &bench, const char *name, MushroomGrid<Grid> &grid,
+                            vec2 *queryPos, vec2 *queryDir, int numQueries, int mushrooms )
+
+{
+  bench.run( name, { { "mushrooms", (double) mushrooms } }, 1,
+             [&]( long iterations ) {
+               for (long i=0; i<iterations; i++) {
+                 MushroomHandle m;
+                 grid.findClosestAhead( queryPos[i % numQueries], queryDir[i % numQueries], worldConfig.rowSpacing / 4, m );
+                 benchKeep( m );
+               }
+             } );
+}
+
+
+static void benchMushroomGrid( Bench &bench )
+
+{
+  if (!StandardGrid::matchesConfig())
+    return;
+
+  const int numMushroomCounts = 3;
+  int mushroomCounts[numMushroomCounts] = { 60, 200, 380 };
+
+  const int numQueries = 256;
+  vec2 queryPos[numQueries];
+  vec2 queryDir[numQueries];
+
+  srand( 1 );
+  for (int i=0; i<numQueries; i++) {
+    queryPos[i] = randomFieldPos();
+    queryDir[i] = (i % 4 == 0 ? vec2( 0, 1 ) : (i % 2 ? vec2( 1, 0 ) : vec2( -1, 0 )));
+  }
+
+  // Each grid gets its own mushrooms, as a mushroom can only be in
+  // one grid's cell lists
+
+  SlotMap<Mushroom> standardMushrooms, runtimeMushrooms;
+
+  MushroomGrid<StandardGrid> *standard = new MushroomGrid<StandardGrid>( standardMushrooms );
+  MushroomGrid<RuntimeGrid>  *runtime  = new MushroomGrid<RuntimeGrid>( runtimeMushrooms );
+
+  for (int m=0; m<numMushroomCounts; m++) {
+
+    standardMushrooms.clear();
+    runtimeMushrooms.clear();
+    standard->clear();
+    runtime->clear();
+
+    for (int i=0; i<mushroomCounts[m]; i++) {
+      vec2 pos = randomGridPos();
+      standard->add( standardMushrooms.add( Mushroom( pos ) ) );
+      runtime->add( runtimeMushrooms.add( Mushroom( pos ) ) );
+    }
+
+    benchGridQuery( bench, "MushroomGrid<StandardGrid>", *standard, queryPos, queryDir, numQueries, mushroomCounts[m] );
+    benchGridQuery( bench, "MushroomGrid<RuntimeGrid>",  *runtime,  queryPos, queryDir, numQueries, mushroomCounts[m] );
+  }
+
+  delete standard;
+  delete runtime;
+}
+
+
+// Centipede::updatePose for one tick, for centipedes of various
+// lengths moving through the default mushroom field
+
+static void benchUpdatePose( Bench &bench )
+
+{
+  const int numLengths = 4;
+  int lengths[numLengths] = { 1, 10, 100, 1000 };
+
+  world->clearEntities();
+  srand( 2 );
+  for (int i=0; i<worldConfig.initNumMushrooms; i++)
+    world->addMushroom( randomGridPos() );
+
+  SegmentStore segs;
+  Centipede cent;
+
+  for (int l=0; l<numLengths; l++)
+    bench.run( "Centipede::updatePose", { { "segments", (double) lengths[l] } }, lengths[l],
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++)
+                   cent.updatePose( TICK_TIME, segs );
+                 benchKeep( segs.posX[0] );
+               },
+               [&]() {
+                 segs.clear();
+                 srand( 3 ); // the head turns randomly in the player area
+                 cent.release();
+                 cent = Centipede( segs, lengths[l], INIT_CENTIPEDE_POS, INIT_CENTIPEDE_DIR );
+               } );
+
+  // Steps of a whole second (as in a fast-forward) with analytic
+  // motion, which advances the head from event to event
+
+  int analytic = worldConfig.analyticMotion;
+  worldConfig.analyticMotion = 1;
+
+  for (int l=0; l<numLengths; l++)
+    bench.run( "Centipede::updatePose 1s step", { { "segments", (double) lengths[l] } }, lengths[l],
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++)
+                   cent.updatePose( 1.0, segs );
+                 benchKeep( segs.posX[0] );
+               },
+               [&]() {
+                 segs.clear();
+                 srand( 3 );
+                 cent.release();
+                 cent = Centipede( segs, lengths[l], INIT_CENTIPEDE_POS, INIT_CENTIPEDE_DIR );
+               } );
+
+  worldConfig.analyticMotion = analytic;
+
+  cent.release(); // give the last ring back to the pool
+}
+
+
+// The dart tests of World::updateDarts.  The darts are stepped by
+// zero time, so nothing is ever hit and the world doesn't change, but
+// each dart still looks for segments and spiders in the grid cells
+// around it.  The darts are among the segments, so those cells aren't
+// empty.
+
+static void benchDartScan( Bench &bench )
+
+{
+  const int numConfigs = 6;
+  int darts[numConfigs]    = { 3,  3,   3,    100,  100,   100 };
+  int segments[numConfigs] = { 10, 100, 1000, 100,  1000,  10000 };
+
+  for (int c=0; c<numConfigs; c++) {
+
+    world->clearEntities();
+    srand( 4 );
+
+    // Centipedes of 10 segments scattered over the field
+
+    for (int s=0; s<segments[c]; s+=10)
+      world->addCentipede( 10, randomFieldPos(), vec2( rand() % 2 ? 1 : -1, 0 ) );
+
+    for (int d=0; d<darts[c]; d++)
+      world->addDart( randomFieldPos() );
+
+    bench.run( "World::updateDarts scan", { { "darts", (double) darts[c] }, { "segments", (double) segments[c] } },
+               darts[c],
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++)
+                   world->updateDarts( 0 );
+               } );
+  }
+}
+
+
+// The sweep kernel of segmentsweep.h on its own, with each kernel
+// that this CPU can run
+
+static void benchSegmentSweep( Bench &bench )
+
+{
+  const int numConfigs = 4;
+  int darts[numConfigs]    = { 3,    100,  300,   500 };
+  int segments[numConfigs] = { 1000, 1000, 10000, 20000 };
+
+  const char *kernels[] = { "scalar", "sse2", "avx2" };
+  const char *original = sweepKernelName();
+
+  for (int c=0; c<numConfigs; c++) {
+
+    seq<float> segX, segY, dartX, dartY;
+    srand( 6 );
+
+    for (int i=0; i<segments[c]; i++) {
+      vec2 pos = randomFieldPos();
+      segX.add( pos.x );
+      segY.add( pos.y );
+    }
+
+    for (int d=0; d<darts[c]; d++) {
+      dartX.add( WORLD_LEFT_EDGE + randIn01() * (WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE) );
+      dartY.add( INIT_PLAYER_POS.y + randIn01() * (WORLD_TOP_ROW - INIT_PLAYER_POS.y) );
+    }
+
+    seq<int> closest( darts[c] );
+    seq<float> dist( darts[c] );
+    for (int d=0; d<darts[c]; d++) {
+      closest.add( -1 );
+      dist.add( 0 );
+    }
+
+    for (int k=0; k<3; k++) {
+
+      if (!useSweepKernel( kernels[k] ))
+        continue;
+
+      char name[64];
+      sprintf( name, "closestSegmentsAhead %s", kernels[k] );
+
+      bench.run( name, { { "darts", (double) darts[c] }, { "segments", (double) segments[c] } },
+                 (long) darts[c] * segments[c],
+                 [&]( long iterations ) {
+                   for (long i=0; i<iterations; i++)
+                     closestSegmentsAhead( dartX.array(), dartY.array(), darts[c], segX.array(), segY.array(), segments[c],
+                                           SEG_BODY_RADIUS, closest.array(), dist.array() );
+                   benchKeep( closest[0] );
+                 } );
+    }
+  }
+
+  useSweepKernel( original );
+}
+
+
+// seq<T>::add, emplace, remove(i) and findIndex, with std::vector
+// doing the same for comparison
+
+static void benchSeq( Bench &bench )
+
+{
+  const int numSizes = 3;
+  int sizes[numSizes] = { 16, 1024, 65536 };
+
+  for (int s=0; s<numSizes; s++) {
+
+    int n = sizes[s];
+
+    // Build a sequence of n elements from empty, including growth
+
+    bench.run( "seq::add", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   seq<int> q;
+                   for (int j=0; j<n; j++)
+                     q.add( j );
+                   benchKeep( q[n-1] );
+                 }
+               } );
+
+    bench.run( "vector::push_back", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   std::vector<int> v;
+                   for (int j=0; j<n; j++)
+                     v.push_back( j );
+                   benchKeep( v[n-1] );
+                 }
+               } );
+
+    // The same with the room reserved first
+
+    bench.run( "seq::add reserved", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   seq<int> q( n );
+                   for (int j=0; j<n; j++)
+                     q.add( j );
+                   benchKeep( q[n-1] );
+                 }
+               } );
+
+    bench.run( "vector::push_back reserved", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   std::vector<int> v;
+                   v.reserve( n );
+                   for (int j=0; j<n; j++)
+                     v.push_back( j );
+                   benchKeep( v[n-1] );
+                 }
+               } );
+
+    // Clear and refill one sequence, as the snapshots are each tick,
+    // which reuses its storage
+
+    seq<int> refilled;
+    std::vector<int> refilledVector;
+
+    bench.run( "seq::clear and add", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   refilled.clear();
+                   for (int j=0; j<n; j++)
+                     refilled.add( j );
+                   benchKeep( refilled[n-1] );
+                 }
+               } );
+
+    bench.run( "vector::clear and push_back", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   refilledVector.clear();
+                   for (int j=0; j<n; j++)
+                     refilledVector.push_back( j );
+                   benchKeep( refilledVector[n-1] );
+                 }
+               } );
+
+    // Build a sequence of n DrawBuffers (each with three sequences of
+    // its own) from empty, so that growth moves elements that own
+    // storage
+
+    bench.run( "seq::emplace DrawBuffers", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   seq<DrawBuffers> q;
+                   for (int j=0; j<n; j++) {
+                     DrawBuffers &db = q.emplace( j );
+                     db.mode.add( GL_TRIANGLES );
+                     db.first.add( 0 );
+                     db.count.add( 3 );
+                   }
+                   benchKeep( q[n-1].VAO );
+                 }
+               } );
+
+    bench.run( "vector::emplace_back DrawBuffers", { { "n", (double) n } }, n,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   std::vector<DrawBuffers> v;
+                   for (int j=0; j<n; j++) {
+                     v.emplace_back( j );
+                     DrawBuffers &db = v.back();
+                     db.mode.add( GL_TRIANGLES );
+                     db.first.add( 0 );
+                     db.count.add( 3 );
+                   }
+                   benchKeep( v[n-1].VAO );
+                 }
+               } );
+
+    seq<int> q;
+
+    // Remove from the middle (shifting half of the elements) and add
+    // to the end again, so that the size stays at n
+
+    bench.run( "seq::remove(i)", { { "n", (double) n } }, 1,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   q.remove( n/2 );
+                   q.add( i );
+                 }
+                 benchKeep( q[0] );
+               },
+               [&]() {
+                 q.clear();
+                 for (int j=0; j<n; j++)
+                   q.add( j );
+               } );
+
+    // Find the last element (a full scan)
+
+    bench.run( "seq::findIndex", { { "n", (double) n } }, 1,
+               [&]( long iterations ) {
+                 for (long i=0; i<iterations; i++) {
+                   int index = q.findIndex( n-1 );
+                   benchKeep( index );
+                 }
+               },
+               [&]() {
+                 q.clear();
+                 for (int j=0; j<n; j++)
+                   q.add( j );
+               } );
+  }
+}
+
+
+// mat4 multiply, translate and rotate (from linalg.cpp)
+
+static void benchLinalg( Bench &bench )
+
+{
+  const int numMatrices = 64;
+  mat4 M[numMatrices];
+  vec3 v[numMatrices];
+
+  srand( 5 );
+  for (int i=0; i<numMatrices; i++) {
+    v[i] = vec3( randIn01(), randIn01(), randIn01() ).normalize();
+    M[i] = translate( v[i] ) * rotate( randIn01() * 2 * M_PI, v[i] );
+  }
+
+  bench.run( "mat4 multiply", {}, 1,
+             [&]( long iterations ) {
+               for (long i=0; i<iterations; i++) {
+                 mat4 P = M[i % numMatrices] * M[(i+1) % numMatrices];
+                 benchKeep( P );
+               }
+             } );
+
+  bench.run( "translate", {}, 1,
+             [&]( long iterations ) {
+               for (long i=0; i<iterations; i++) {
+                 vec3 &t = v[i % numMatrices];
+                 mat4 T = translate( t.x, t.y, t.z );
+                 benchKeep( T );
+               }
+             } );
+
+  bench.run( "rotate", {}, 1,
+             [&]( long iterations ) {
+               for (long i=0; i<iterations; i++) {
+                 mat4 R = rotate( 0.001f * i, v[i % numMatrices] );
+                 benchKeep( R );
+               }
+             } );
+}
+
+
+int main( int argc, char **argv )
+
+{
+  Bench bench( "micro" );
+
+  if (!bench.parseArgs( argc, argv ))
+    return 1;
+
+  world = new World();
+
+  benchFindClosestMushroom( bench );
+  benchMushroomGrid( bench );
+  benchUpdatePose( bench );
+  benchDartScan( bench );
+  benchSegmentSweep( bench );
+  benchSeq( bench );
+  benchLinalg( bench );
+
+  return bench.finish() ? 0 : 1;
+}
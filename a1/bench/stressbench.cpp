@@ -0,0 +1,271 @@
+// stressbench.cpp
+//
+// A headless macro benchmark of World::updateState at increasing
+// scale: from the default game up to thousands of centipedes, a
+// million mushrooms, hundreds of darts and a hundred spiders.  Build
+// and run with "make stressbench" in ../linux.
+//
+// Each scale point builds a scenario, then times whole ticks while a
+// scripted bot plays: it sweeps the player along the bottom and fires
+// to keep the scenario's number of darts in the air.  Spiders, and
+// centipede segments that have been shot, are topped up in the same
+// way.  The player can't die and the centipedes are never all gone,
+// so the scenario isn't replaced by a new level part-way through.
+//
+// For each scale point this reports ticks per second, ns per entity
+// per tick, the resident memory of the process, and the number of
+// times the entity pools went to the heap in the last timed run (see
+// pool.h).
+//
+// The playing field is the grid set by the world config (20 x 19 by
+// default, or see -config and -set), so at the larger scales many
+// mushrooms share a grid position.  That doesn't change the cost of
+// the collision loops, which is what this measures.
+
+
+#include "headers.h"
+#include "world.h"
+#include "bench.h"
+
+#include <algorithm>
+
+#ifdef LINUX
+  #include <sys/resource.h>
+#endif
+
+
+// Globals that the game's objects expect main.cpp to define
+
+GLFWwindow *window = NULL;
+GPUProgram *gpuProg = NULL;
+World *world = NULL;
+bool pauseGame = false;
+float speedMultiplier = 1.0;
+
+
+#define TICK_TIME (1.0 / SIM_TICKS_PER_SECOND)
+
+#define BOT_SWEEP_PERIOD 4.0 // seconds for the bot to sweep across and back
+
+
+struct Scale {
+  int centipedes;
+  int segmentsPerCentipede;
+  int mushrooms;
+  int darts;
+  int spiders;
+};
+
+Scale scales[] = {
+  {    1, 10,      60,   3,   1 }, // the default game
+  {   10, 10,    1000,  10,   2 },
+  {  100, 10,   10000, 100,  10 },
+  { 1000, 10,  100000, 300,  50 },
+  { 2000, 10, 1000000, 500, 100 }
+};
+
+const int numScales = sizeof(scales) / sizeof(scales[0]);
+
+
+// Resident and peak resident memory of this process, in MB (0 if not
+// available on this platform)
+
+static double residentMB()
+
+{
+#ifdef LINUX
+  FILE *f = fopen( "/proc/self/statm", "r" );
+  if (f == NULL)
+    return 0;
+
+  long pages, resident;
+  int n = fscanf( f, "%ld %ld", &pages, &resident );
+  fclose( f );
+
+  return (n == 2 ? resident * (double) sysconf( _SC_PAGESIZE ) / (1024 * 1024) : 0);
+#else
+  return 0;
+#endif
+}
+
+
+static double peakResidentMB()
+
+{
+#ifdef LINUX
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  return usage.ru_maxrss / 1024.0; // ru_maxrss is in kB
+#else
+  return 0;
+#endif
+}
+
+
+static vec2 randomGridPos( int numCols )
+
+{
+  int r = rand() % worldConfig.numRows;
+  int c = rand() % numCols;
+
+  return vec2( WORLD_LEFT_EDGE + (c + 1) * worldConfig.colSpacing, WORLD_TOP_ROW - r * worldConfig.rowSpacing );
+}
+
+
+// Add a spider entering from one side, as in World::updateSpider
+
+static void addSpider()
+
+{
+  bool fromLeft = (rand() % 2) == 0;
+
+  float x = fromLeft ? (WORLD_LEFT_EDGE - 2 * worldConfig.colSpacing) : (WORLD_RIGHT_EDGE + 2 * worldConfig.colSpacing);
+  float y = -1.0f + 2.5f * worldConfig.rowSpacing + (rand() % 4) * 0.5f * worldConfig.rowSpacing;
+
+  float vx = fromLeft ? +worldConfig.spiderSpeedX : -worldConfig.spiderSpeedX;
+  float vy = (rand() % 3 - 1) * worldConfig.spiderSpeedY;
+
+  world->addSpider( vec2( x, y ), vec2( vx, vy ) );
+}
+
+
+// Add a centipede of 'numSegs' segments with its head on the top half
+// of the grid, heading either way
+
+static void addCentipede( int numSegs, int numCols )
+
+{
+  vec2 head = randomGridPos( numCols );
+  head.y = WORLD_TOP_ROW - (rand() % (worldConfig.numRows / 2)) * worldConfig.rowSpacing;
+  world->addCentipede( numSegs, head, vec2( rand() % 2 ? 1 : -1, 0 ) );
+}
+
+
+// Replace the world's entities with those of scale point 's'
+
+static void buildScenario( Scale &s, int seed )
+
+{
+  world->clearEntities();
+  world->playerInvulnerable = true;
+
+  srand( seed );
+
+  int numCols = worldConfig.numCols();
+
+  for (int i=0; i<s.mushrooms; i++)
+    world->addMushroom( randomGridPos( numCols ) );
+
+  for (int i=0; i<s.centipedes; i++)
+    addCentipede( s.segmentsPerCentipede, numCols );
+
+  for (int i=0; i<s.spiders; i++)
+    addSpider();
+}
+
+
+// One tick of the bot: move the player, fire if there are fewer darts
+// in the air than the scenario calls for, and replace spiders that
+// have left or been shot and centipede segments that have been shot.
+//
+// With many darts, the bot has "wingmen" spread evenly across the
+// field, so that the darts don't all travel up the same column.
+
+static void botStep( Scale &s, unsigned int tick )
+
+{
+  float t = tick * TICK_TIME;
+  float x = 0.9 * WORLD_RIGHT_EDGE * sin( 2 * M_PI * t / BOT_SWEEP_PERIOD );
+
+  vec2 pos = Player::clampToPlayerArea( vec2( x, INIT_PLAYER_POS.y ) );
+  world->playerMove( pos );
+
+  int guns = 1 + s.darts / 40;
+  int toFire = std::min( s.darts - world->numDarts(), guns );
+  float width = WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE;
+
+  for (int i=0; i<toFire; i++) {
+    float dx = pos.x + i * width / guns;
+    if (dx > WORLD_RIGHT_EDGE)
+      dx -= width;
+    world->addDart( vec2( dx, pos.y ) );
+  }
+
+  while (world->numSpiders() < s.spiders)
+    addSpider();
+
+  int missingSegments = s.centipedes * s.segmentsPerCentipede - world->numSegments();
+
+  while (missingSegments > 0) {
+    int numSegs = std::min( missingSegments, s.segmentsPerCentipede );
+    addCentipede( numSegs, worldConfig.numCols() );
+    missingSegments -= numSegs;
+  }
+}
+
+
+int main( int argc, char **argv )
+
+{
+  Bench bench( "stress" );
+
+  bench.setDefaults( 3, 1, 200 );
+
+  if (!bench.parseArgs( argc, argv ))
+    return 1;
+
+  world = new World();
+
+  for (int i=0; i<numScales; i++) {
+
+    Scale &s = scales[i];
+
+    char name[64];
+    sprintf( name, "stress s%d", i+1 );
+
+    unsigned int tick = 0;
+    int entities = 0;
+    long poolAllocations = 0;
+
+    bench.run( name,
+               { { "centipedes", (double) s.centipedes },
+                 { "segments",   (double) s.centipedes * s.segmentsPerCentipede },
+                 { "mushrooms",  (double) s.mushrooms },
+                 { "darts",      (double) s.darts },
+                 { "spiders",    (double) s.spiders } },
+               1,
+               [&]( long iterations ) {
+                 for (long j=0; j<iterations; j++) {
+                   botStep( s, tick++ );
+                   world->updateState( TICK_TIME );
+                 }
+               },
+               [&]() {
+                 buildScenario( s, i+1 );
+                 tick = 0;
+                 entities = world->numSegments() + world->numMushrooms() + world->numDarts() + world->numSpiders();
+                 poolAllocations = poolHeapAllocations;
+               } );
+
+    if (bench.last() == NULL)
+      continue;
+
+    double nsPerTick = bench.last()->median;
+    double rss = residentMB();
+
+    poolAllocations = poolHeapAllocations - poolAllocations;
+
+    bench.note( "ticks_per_sec", 1e9 / nsPerTick );
+    bench.note( "ns_per_entity", nsPerTick / entities );
+    bench.note( "entities", entities );
+    bench.note( "rss_mb", rss );
+    bench.note( "peak_rss_mb", peakResidentMB() );
+    bench.note( "pool_heap_allocations", poolAllocations );
+
+    printf( "    %.1f ticks/s  %.2f ns/entity  %d entities  rss %.1f MB (peak %.1f MB)  %ld pool allocations\n",
+            1e9 / nsPerTick, nsPerTick / entities, entities, rss, peakResidentMB(), poolAllocations );
+    fflush( stdout );
+  }
+
+  return bench.finish() ? 0 : 1;
+}
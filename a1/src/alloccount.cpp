@@ -0,0 +1,98 @@
+// alloccount.cpp
+//
+// See alloccount.h.  Nothing in here is compiled unless PROFILE is
+// defined.
+
+
+#ifdef PROFILE
+
+#include "alloccount.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+static thread_local unsigned long long threadAllocs = 0;
+static thread_local unsigned long long threadBytes = 0;
+
+static std::atomic<unsigned long long> totalAllocs( 0 );
+static std::atomic<unsigned long long> totalBytes( 0 );
+
+
+AllocCount threadAllocCount()
+
+{
+  AllocCount c = { threadAllocs, threadBytes };
+  return c;
+}
+
+
+AllocCount totalAllocCount()
+
+{
+  AllocCount c = { totalAllocs.load(), totalBytes.load() };
+  return c;
+}
+
+
+void countAllocation( size_t bytes )
+
+{
+  threadAllocs++;
+  threadBytes += bytes;
+
+  totalAllocs.fetch_add( 1, std::memory_order_relaxed );
+  totalBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+
+static void *countedAlloc( size_t size )
+
+{
+  countAllocation( size );
+
+  return malloc( size > 0 ? size : 1 );
+}
+
+
+void *operator new( size_t size )
+
+{
+  void *p = countedAlloc( size );
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+
+void *operator new[]( size_t size )
+
+{
+  void *p = countedAlloc( size );
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+
+void *operator new( size_t size, const std::nothrow_t & ) noexcept
+
+{
+  return countedAlloc( size );
+}
+
+
+void *operator new[]( size_t size, const std::nothrow_t & ) noexcept
+
+{
+  return countedAlloc( size );
+}
+
+
+void operator delete( void *p ) noexcept                          { free( p ); }
+void operator delete[]( void *p ) noexcept                        { free( p ); }
+void operator delete( void *p, const std::nothrow_t & ) noexcept   { free( p ); }
+void operator delete[]( void *p, const std::nothrow_t & ) noexcept { free( p ); }
+
+#endif
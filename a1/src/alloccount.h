@@ -0,0 +1,43 @@
+// alloccount.h
+//
+// Counts of heap allocations, for the profiler and for checking that
+// steady play doesn't allocate.
+//
+// With PROFILE, the global operator new and operator delete are
+// replaced (in alloccount.cpp) by versions that count every allocation
+// and its size, both for the calling thread and for the whole process,
+// and then call malloc and free.  Each PROFILE_SCOPE records the
+// allocations that its thread made inside it (see profiler.h).  Memory
+// taken with malloc directly, including by the C library's own
+// buffers, isn't counted, unless it's counted by hand with
+// COUNT_ALLOCATION (as seq.h does).
+//
+// Without PROFILE, nothing is replaced and there are no counts.
+
+
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#ifdef PROFILE
+
+#include <stddef.h>
+
+struct AllocCount {
+  unsigned long long allocs;
+  unsigned long long bytes;
+};
+
+AllocCount threadAllocCount();  // allocations by the calling thread so far
+AllocCount totalAllocCount();   // allocations by all threads so far
+
+void countAllocation( size_t bytes ); // count one that didn't go through operator new
+
+#define COUNT_ALLOCATION(bytes) countAllocation( bytes )
+
+#else
+
+#define COUNT_ALLOCATION(bytes)
+
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+// arena.cpp
+
+
+#include "arena.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+
+FrameArena frameArena( FRAME_ARENA_SIZE );
+
+
+static size_t roundUp( size_t bytes )
+
+{
+  return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+
+FrameArena::FrameArena( size_t _size )
+
+{
+  size = roundUp( _size );
+  block = new char[ size ];
+  used = 0;
+  overflowBytes = 0;
+  last = NULL;
+  heapAllocations = 1;
+}
+
+
+FrameArena::~FrameArena()
+
+{
+  reset();
+  delete [] block;
+}
+
+
+void *FrameArena::alloc( size_t bytes )
+
+{
+  bytes = roundUp( bytes );
+
+  if (used + bytes <= size) {
+    last = block + used;
+    used += bytes;
+  }
+  else {
+    last = new char[ bytes ];   // for this frame only
+    overflow.add( last );
+    overflowBytes += bytes;
+    heapAllocations++;
+  }
+
+  return last;
+}
+
+
+void *FrameArena::extend( void *p, size_t oldBytes, size_t newBytes )
+
+{
+  oldBytes = roundUp( oldBytes );
+  newBytes = roundUp( newBytes );
+
+  if (p == last && last == block + used - oldBytes && used - oldBytes + newBytes <= size) {
+    used += newBytes - oldBytes;
+    return p;
+  }
+
+  void *q = alloc( newBytes );
+  memcpy( q, p, oldBytes );
+  return q;
+}
+
+
+// If the last frame overflowed the block, replace the block with one
+// that would have held it all
+
+void FrameArena::reset()
+
+{
+  if (overflow.size() > 0) {
+
+    for (int i=0; i<overflow.size(); i++)
+      delete [] overflow[i];
+
+    overflow.clear();
+
+    delete [] block;
+    size = roundUp( used + overflowBytes );
+    block = new char[ size ];
+    heapAllocations++;
+
+    overflowBytes = 0;
+  }
+
+  used = 0;
+  last = NULL;
+}
+
+
+FrameString::FrameString( FrameArena &a ) : arena( a )
+
+{
+  capacity = 64;
+  str = arena.alloc<char>( capacity );
+  str[0] = '\0';
+  length = 0;
+}
+
+
+FrameString &FrameString::printf( const char *format, ... )
+
+{
+  va_list args;
+
+  va_start( args, format );
+  int n = vsnprintf( str + length, capacity - length, format, args );
+  va_end( args );
+
+  if (n < 0)
+    return *this;
+
+  if (length + n >= capacity) { // didn't fit: make room and format it again
+
+    int newCapacity = 2 * capacity;
+    while (length + n >= newCapacity)
+      newCapacity *= 2;
+
+    str = (char *) arena.extend( str, capacity, newCapacity );
+    capacity = newCapacity;
+
+    va_start( args, format );
+    vsnprintf( str + length, capacity - length, format, args );
+    va_end( args );
+  }
+
+  length += n;
+
+  return *this;
+}
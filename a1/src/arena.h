@@ -0,0 +1,85 @@
+// arena.h
+//
+// A linear ("bump") arena for the short-lived data of one frame, such
+// as the text of the status line and the vertices of a stroke.
+//
+// alloc() hands out the next bytes of one big block, and reset() takes
+// them all back at once, so there's nothing to free and nothing to
+// fragment.  If a frame needs more than the block holds, the rest comes
+// from the heap for that frame, and at the next reset() the block is
+// replaced by one big enough for everything the frame needed.  After
+// that, frames of the same size don't touch the heap.
+//
+// frameArena belongs to the main thread, which resets it at the top of
+// each frame.  Memory from it is only good until then.  The arena isn't
+// thread safe, so the simulation thread and the jobs don't use it.
+//
+// FrameString builds a string in an arena, in place of a stringstream:
+//
+//     FrameString str( frameArena );
+//     str.printf( "Score %d", score );
+//     drawStrokeString( str.c_str(), ... );
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "seq.h"
+
+#include <stddef.h>
+
+#define FRAME_ARENA_SIZE  65536 // initial size of frameArena's block
+#define ARENA_ALIGNMENT   16    // of every allocation
+
+
+class FrameArena {
+
+  char *block;
+  size_t size;                  // of 'block'
+  size_t used;                  //   and how much of it has been handed out
+
+  seq<char *> overflow;         // blocks from the heap for this frame
+  size_t overflowBytes;
+
+  char *last;                   // the most recent allocation, which can be extended
+
+ public:
+
+  long heapAllocations;         // number of times the arena has gone to the heap
+
+  FrameArena( size_t size );
+  ~FrameArena();
+
+  void *alloc( size_t bytes );
+  template<class T> T *alloc( int n ) { return (T *) alloc( n * sizeof(T) ); }
+
+  // Grow allocation 'p' from 'oldBytes' to 'newBytes', in place if it's
+  // the most recent one and there's room, or else by copying it.
+  // Returns where it now is.
+
+  void *extend( void *p, size_t oldBytes, size_t newBytes );
+
+  void reset();                 // take back everything
+};
+
+
+extern FrameArena frameArena;
+
+
+class FrameString {
+
+  FrameArena &arena;
+  char *str;
+  int length, capacity;
+
+ public:
+
+  FrameString( FrameArena &a );
+
+  FrameString &printf( const char *format, ... ); // append
+
+  const char *c_str() const { return str; }
+  int size() const { return length; }
+};
+
+#endif
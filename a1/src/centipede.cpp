@@ -2,6 +2,8 @@
 
 #include "centipede.h"
 #include "main.h"
+#include "vertexformat.h"
+#include "jobs.h"
 
 // VAOs for the centipede segments
 
@@ -16,183 +18,443 @@ extern GLFWwindow *window;
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-void Centipede::updatePose(float elapsedTime)
+// Add a segment that isn't turning
+
+int SegmentStore::add(vec2 pos, vec2 dir)
 
 {
-  // Determine distance travelled
+  posX.add(pos.x);
+  posY.add(pos.y);
+  dirX.add(dir.x);
+  dirY.add(dir.y);
+  prevX.add(pos.x);
+  prevY.add(pos.y);
+
+  turning.add(false);
+  turnAngle.add(0);
+  turnCentreX.add(0);
+  turnCentreY.add(0);
+  dirUponTurnEntry.add(0);
+  turnDir.add(0);
+
+  return size() - 1;
+}
 
-  float distanceToTravel = elapsedTime * (CENTIPEDE_INIT_SPEED + world->level * CENTIPEDE_SPEED_INC_PER_LEVEL) * speedMultiplier;
+void SegmentStore::move(int to, int from)
 
-  // If the head is not already turning, check for an obstacle ahead
-  // and return its position.  However, if the head is on the last
-  // row, don't check for anything and let it continue off the edge of
-  // the screen.
+{
+  posX[to] = posX[from];
+  posY[to] = posY[from];
+  dirX[to] = dirX[from];
+  dirY[to] = dirY[from];
+  prevX[to] = prevX[from];
+  prevY[to] = prevY[from];
+
+  turning[to] = turning[from];
+  turnAngle[to] = turnAngle[from];
+  turnCentreX[to] = turnCentreX[from];
+  turnCentreY[to] = turnCentreY[from];
+  dirUponTurnEntry[to] = dirUponTurnEntry[from];
+  turnDir[to] = turnDir[from];
+}
 
-  float turningPositionX = MAXFLOAT;
+void SegmentStore::truncate(int n)
+
+{
+  posX.truncate(n);
+  posY.truncate(n);
+  dirX.truncate(n);
+  dirY.truncate(n);
+  prevX.truncate(n);
+  prevY.truncate(n);
+
+  turning.truncate(n);
+  turnAngle.truncate(n);
+  turnCentreX.truncate(n);
+  turnCentreY.truncate(n);
+  dirUponTurnEntry.truncate(n);
+  turnDir.truncate(n);
+}
 
-  if (!segments[0]->turning)
+void SegmentStore::savePositions()
+
+{
+  float *x = posX.array(), *y = posY.array();
+  float *px = prevX.array(), *py = prevY.array();
+
+  for (int i = 0; i < size(); i++)
   {
+    px[i] = x[i];
+    py[i] = y[i];
+  }
+}
 
-    if (segments[0]->dir.x < 0) // moving left
-      turningPositionX = WORLD_LEFT_EDGE + 4 * SEG_BODY_RADIUS;
-    else // moving right
-      turningPositionX = WORLD_RIGHT_EDGE - 4 * SEG_BODY_RADIUS;
+void SegmentStore::clear()
 
-    // If there's a closer mushroom, set 'turningPositionX' to that
-    // mushroom's x position
+{
+  truncate(0);
+  numHoles = 0;
+}
 
-    Mushroom *closestMush = world->findClosestMushroomAhead(segments[0]->pos, segments[0]->dir, ROW_SPACING / 4);
+PowerOfTwoPool<PathPoint> CentipedePath::ringPool;
 
-    if (closestMush)
-      if (segments[0]->dir.x < 0)
-      { // moving left
-        if (closestMush->pos.x > turningPositionX)
-          turningPositionX = closestMush->pos.x;
-      }
-      else // moving right
-        if (closestMush->pos.x < turningPositionX)
-          turningPositionX = closestMush->pos.x;
+// The ring holds the samples from the tail to the head (plus one, and
+// a few spare), rounded up to a power of two
+
+long CentipedePath::ringSize(int numSegs)
+
+{
+  long size = 1;
+  while (size < (long)numSegs * PATH_SAMPLES_PER_SEG + 4)
+    size *= 2;
+
+  return size;
+}
+
+void CentipedePath::init(int numSegs)
+
+{
+  long size = ringSize(numSegs);
+
+  ring = ringPool.alloc(size);
+  memset(ring, 0, size * sizeof(PathPoint));
+
+  mask = size - 1;
+}
+
+void CentipedePath::release()
+
+{
+  if (ring)
+    ringPool.free(ring, mask + 1);
+
+  ring = NULL;
+}
+
+void CentipedePath::reserve(int numSegs, int count)
+
+{
+  ringPool.reserve(ringSize(numSegs), count);
+}
+
+// Set up segments with head at headPos, and each other segment in
+// the -dir direction from the head, with 'SEG_SEG_DISTANCE' spacing
+// so that they overlap a bit.
+
+Centipede::Centipede(SegmentStore &segs, int _numSegs, vec2 headPos, vec2 dir)
+
+{
+  first = segs.size();
+  numSegs = _numSegs;
 
-    // Move the turning position closer to the centipede so that it
-    // turns in time.
+  for (int i = 0; i < numSegs; i++)
+    segs.add(headPos - i * SEG_SEG_DISTANCE * dir, dir);
+
+  // The path so far is the straight line from behind the tail to the
+  // head
+
+  path.init(numSegs);
+
+  path.newest = -2; // one sample behind the tail, in case of rounding
+  path.headArc = -PATH_SAMPLE_SPACING;
+
+  recordStraight(headPos - (float)((numSegs - 1) * SEG_SEG_DISTANCE + PATH_SAMPLE_SPACING) * dir, dir,
+                 (numSegs - 1) * SEG_SEG_DISTANCE + PATH_SAMPLE_SPACING, 0);
+}
+
+// Record the samples that the head passes on a straight piece of
+// path, starting at 'from'
+
+void Centipede::recordStraight(vec2 from, vec2 dir, float length, int turnDir)
+
+{
+  double arc0 = path.headArc;
+
+  path.headArc += length;
+  path.skipTo(path.headArc);
+
+  PathPoint p;
+
+  p.dirX = dir.x;
+  p.dirY = dir.y;
+  p.turning = false;
+  p.turnAngle = 0;
+  p.turnCentreX = 0;
+  p.turnCentreY = 0;
+  p.dirUponTurnEntry = 0;
+  p.turnDir = turnDir;
+
+  while ((path.newest + 1) * PATH_SAMPLE_SPACING <= path.headArc)
+  {
+    double s = (path.newest + 1) * PATH_SAMPLE_SPACING - arc0;
 
-    if (segments[0]->dir.x < 0)
-      turningPositionX = MIN(turningPositionX + COL_SPACING, segments[0]->pos.x);
-    else
-      turningPositionX = MAX(turningPositionX - COL_SPACING, segments[0]->pos.x);
+    p.x = from.x + s * dir.x;
+    p.y = from.y + s * dir.y;
+
+    path.add(p);
   }
+}
+
+// Record the samples that the head passes in a turn, starting at
+// 'fromAngle'.  'turn' has the turn's centre and directions.
+
+void Centipede::recordTurn(PathPoint turn, float fromAngle, float length)
+
+{
+  double arc0 = path.headArc;
+  double radius = CENTIPEDE_TURN_RADIUS;
+
+  path.headArc += length;
+  path.skipTo(path.headArc);
 
-  // Update each segment position. If the segment is turning,
-  // continue its turn until 'distance' has been travelled or the
-  // segment comes out of the turn.
+  turn.turning = true;
 
-  for (int i = 0; i < segments.size(); i++)
+  while ((path.newest + 1) * PATH_SAMPLE_SPACING <= path.headArc)
   {
+    double angle = fromAngle + ((path.newest + 1) * PATH_SAMPLE_SPACING - arc0) / radius;
 
-    float distanceRemaining = distanceToTravel;
+    turn.turnAngle = angle;
 
-    float dir = signum(segments[i]->dir.x); // direction in x as +1 or -1
+    turn.dirX = turn.dirUponTurnEntry * cos(angle);
+    turn.dirY = turn.turnDir * sin(angle);
 
-    while (distanceRemaining > 0)
-    {
+    turn.x = turn.turnCentreX + radius * turn.dirUponTurnEntry * sin(angle);
+    turn.y = turn.turnCentreY - radius * turn.turnDir * cos(angle);
 
-      // Step 1: If not turning already, travel horizontally as far as
-      // possible without entering the next turn.
+    path.add(turn);
+  }
+}
 
-      if (!segments[i]->turning)
+// The x position at which the head, going straight, will start its
+// next turn: a column before the closest mushroom ahead, or before
+// the edge of the field.  However, if the head is on the last row,
+// don't check for anything and let it continue off the edge of the
+// screen.
 
-        if (turningPositionX == MAXFLOAT || distanceRemaining < dir * (turningPositionX - segments[i]->pos.x))
-        {
+float Centipede::nextTurningPositionX(SegmentStore &segs)
 
-          // No turning point, or distance to turning point is greater
-          // than distance remaining to travel, so just travel
+{
+  int h = first;
 
-          segments[i]->pos = segments[i]->pos + distanceRemaining * segments[i]->dir;
+  float turningPositionX;
 
-          distanceRemaining = 0;
-        }
-        else
-        {
+  if (segs.dirX[h] < 0) // moving left
+    turningPositionX = WORLD_LEFT_EDGE + 4 * SEG_BODY_RADIUS;
+  else // moving right
+    turningPositionX = WORLD_RIGHT_EDGE - 4 * SEG_BODY_RADIUS;
 
-          // Will reach the turning point before the distance to travel,
-          // so move to turning point, then start turning.
+  // If there's a closer mushroom, set 'turningPositionX' to that
+  // mushroom's x position
 
-          distanceRemaining -= fabs(turningPositionX - segments[i]->pos.x);
+  Mushroom *closestMush = world->mushroom(world->findClosestMushroomAhead(segs.pos(h), segs.dir(h), worldConfig.rowSpacing / 4));
 
-          segments[i]->pos.x = turningPositionX; // advance
+  if (closestMush)
+    if (segs.dirX[h] < 0)
+    { // moving left
+      if (closestMush->pos.x > turningPositionX)
+        turningPositionX = closestMush->pos.x;
+    }
+    else // moving right
+      if (closestMush->pos.x < turningPositionX)
+        turningPositionX = closestMush->pos.x;
+
+  // Move the turning position closer to the centipede so that it
+  // turns in time.
+
+  if (segs.dirX[h] < 0)
+    turningPositionX = MIN(turningPositionX + worldConfig.colSpacing, segs.posX[h]);
+  else
+    turningPositionX = MAX(turningPositionX - worldConfig.colSpacing, segs.posX[h]);
+
+  return turningPositionX;
+}
 
-          segments[i]->turning = true; // start turning
-          segments[i]->turnAngle = 0;
-          segments[i]->dirUponTurnEntry = dir;
-          segments[i]->turningPositionX = turningPositionX;
+void Centipede::updatePose(float elapsedTime, SegmentStore &segs)
 
-          // Choose whether to turn upward or downward
+{
+  // This centipede's span of each array of segment state.  Only the
+  // head's turn state is used.
+
+  float *posX = segs.posX.array() + first;
+  float *posY = segs.posY.array() + first;
+  float *dirX = segs.dirX.array() + first;
+  float *dirY = segs.dirY.array() + first;
+  bool *turning = segs.turning.array() + first;
+  float *turnAngle = segs.turnAngle.array() + first;
+  float *turnCentreX = segs.turnCentreX.array() + first;
+  float *turnCentreY = segs.turnCentreY.array() + first;
+  float *dirUponTurnEntry = segs.dirUponTurnEntry.array() + first;
+  int *turnDir = segs.turnDir.array() + first;
+
+  float turnRadius = CENTIPEDE_TURN_RADIUS; // (as a float, as it was when multiplying a vec2)
 
-          if (i == 0)
-          {
+  // Determine distance travelled
 
-            // For the head, turn down unless inside the player area
+  float distanceToTravel = elapsedTime * (worldConfig.centipedeInitSpeed + world->level * worldConfig.centipedeSpeedIncPerLevel) * speedMultiplier;
 
-            if (segments[0]->pos.y < WORLD_BOTTOM_ROW - 2 * ROW_SPACING)
-            { // turn up or down if in player area
+  // If the head is not already turning, find where it will next
+  // turn
 
-              if (segments[0]->pos.y < -1 + 1.5 * ROW_SPACING) // turn up if on last row
-                segments[0]->turnDir = +1;
-              else
-                segments[0]->turnDir = (randIn01() > 0.5 ? -1 : +1); // turn randomly otherwise
-            }
-            else // not yet in player area
+  float turningPositionX = MAXFLOAT;
 
-              segments[0]->turnDir = -1; // turn down
-          }
-          else // For body segments, copy the turning direction of the segment in front
+  if (!turning[0])
+    turningPositionX = nextTurningPositionX(segs);
 
-            segments[i]->turnDir = segments[i - 1]->turnDir;
+  // Update the head position. If the head is turning, continue its
+  // turn until 'distance' has been travelled or the head comes out of
+  // the turn.  Each piece of the head's movement is recorded in the
+  // path.
 
-          // Determine the turn centre
+  float distanceRemaining = distanceToTravel;
 
-          if (segments[i]->turnDir == -1) // downward
-            segments[i]->turnCentre = vec2(segments[i]->pos.x, segments[i]->pos.y - CENTIPEDE_TURN_RADIUS);
-          else // upward
-            segments[i]->turnCentre = vec2(segments[i]->pos.x, segments[i]->pos.y + CENTIPEDE_TURN_RADIUS);
+  float dir = signum(dirX[0]); // direction in x as +1 or -1
 
-          // If this is a non-head segment (which has started
-          // turning), the 'turningPositionX' should be set to
-          // MAXFLOAT in the *preceding* segment, since that preceding
-          // segment no longer has to inform the segment behind of the
-          // turn.
+  while (distanceRemaining > 0)
+  {
 
-          if (i > 0)
-            segments[i - 1]->turningPositionX = MAXFLOAT;
-        }
+    // Step 1: If not turning already, travel horizontally as far as
+    // possible without entering the next turn.
 
-      // Step 2: If turning, travel in the turn as far as possible
-      // without leaving the turn.
+    if (!turning[0])
 
-      if (segments[i]->turning)
+      if (turningPositionX == MAXFLOAT || distanceRemaining < dir * (turningPositionX - posX[0]))
       {
 
-        float distRemainingInTurn = CENTIPEDE_TURN_RADIUS * (M_PI - segments[i]->turnAngle); // turn takes from 0 to pi radians (i.e. 180 degrees)
+        // No turning point, or distance to turning point is greater
+        // than distance remaining to travel, so just travel
 
-        if (distanceRemaining < distRemainingInTurn)
-        {
+        recordStraight(vec2(posX[0], posY[0]), vec2(dirX[0], dirY[0]), distanceRemaining, turnDir[0]);
 
-          // Distance to turn exit is greater than distance remaining to
-          // travel, so just travel along the turn.
+        posX[0] = posX[0] + distanceRemaining * dirX[0];
+        posY[0] = posY[0] + distanceRemaining * dirY[0];
 
-          segments[i]->turnAngle += distanceRemaining / CENTIPEDE_TURN_RADIUS;
+        distanceRemaining = 0;
+      }
+      else
+      {
+
+        // Will reach the turning point before the distance to travel,
+        // so move to turning point, then start turning.
+
+        recordStraight(vec2(posX[0], posY[0]), vec2(dirX[0], dirY[0]), fabs(turningPositionX - posX[0]), turnDir[0]);
+
+        distanceRemaining -= fabs(turningPositionX - posX[0]);
+
+        posX[0] = turningPositionX; // advance
+
+        turning[0] = true; // start turning
+        turnAngle[0] = 0;
+        dirUponTurnEntry[0] = dir;
 
-          segments[i]->dir = vec2(segments[i]->dirUponTurnEntry * cos(segments[i]->turnAngle),
-                                  segments[i]->turnDir * sin(segments[i]->turnAngle));
+        // Turn down unless inside the player area
 
-          segments[i]->pos = segments[i]->turnCentre + CENTIPEDE_TURN_RADIUS * vec2(segments[i]->dirUponTurnEntry * sin(segments[i]->turnAngle),
-                                                                                    -segments[i]->turnDir * cos(segments[i]->turnAngle));
+        if (posY[0] < WORLD_BOTTOM_ROW - 2 * worldConfig.rowSpacing)
+        { // turn up or down if in player area
 
-          distanceRemaining = 0;
+          if (posY[0] < -1 + 1.5 * worldConfig.rowSpacing) // turn up if on last row
+            turnDir[0] = +1;
+          else
+            turnDir[0] = (random.in01() > 0.5 ? -1 : +1); // turn randomly otherwise
         }
-        else
-        {
+        else // not yet in player area
+
+          turnDir[0] = -1; // turn down
 
-          // Will reach turn exit before the distance to travel, so
-          // move to the turn exit, then start going straight.
+        // Determine the turn centre
 
-          segments[i]->pos = segments[i]->turnCentre + vec2(0, segments[i]->turnDir * CENTIPEDE_TURN_RADIUS);
-          segments[i]->dir = vec2(-segments[i]->dirUponTurnEntry, 0);
+        turnCentreX[0] = posX[0];
+
+        if (turnDir[0] == -1) // downward
+          turnCentreY[0] = posY[0] - CENTIPEDE_TURN_RADIUS;
+        else // upward
+          turnCentreY[0] = posY[0] + CENTIPEDE_TURN_RADIUS;
+      }
+
+    // Step 2: If turning, travel in the turn as far as possible
+    // without leaving the turn.
+
+    if (turning[0])
+    {
 
-          distanceRemaining -= distRemainingInTurn;
+      PathPoint turn;
 
-          segments[i]->turning = false;
+      turn.turnCentreX = turnCentreX[0];
+      turn.turnCentreY = turnCentreY[0];
+      turn.dirUponTurnEntry = dirUponTurnEntry[0];
+      turn.turnDir = turnDir[0];
+
+      float distRemainingInTurn = CENTIPEDE_TURN_RADIUS * (M_PI - turnAngle[0]); // turn takes from 0 to pi radians (i.e. 180 degrees)
+
+      if (distanceRemaining < distRemainingInTurn)
+      {
+
+        // Distance to turn exit is greater than distance remaining to
+        // travel, so just travel along the turn.
+
+        recordTurn(turn, turnAngle[0], distanceRemaining);
+
+        turnAngle[0] += distanceRemaining / CENTIPEDE_TURN_RADIUS;
+
+        dirX[0] = dirUponTurnEntry[0] * cos(turnAngle[0]);
+        dirY[0] = turnDir[0] * sin(turnAngle[0]);
+
+        float offsetX = dirUponTurnEntry[0] * sin(turnAngle[0]);
+        float offsetY = -turnDir[0] * cos(turnAngle[0]);
+
+        posX[0] = turnCentreX[0] + turnRadius * offsetX;
+        posY[0] = turnCentreY[0] + turnRadius * offsetY;
+
+        distanceRemaining = 0;
+      }
+      else
+      {
+
+        // Will reach turn exit before the distance to travel, so
+        // move to the turn exit, then start going straight.
+
+        recordTurn(turn, turnAngle[0], distRemainingInTurn);
+
+        float exitOffsetY = turnDir[0] * CENTIPEDE_TURN_RADIUS;
+
+        posX[0] = turnCentreX[0];
+        posY[0] = turnCentreY[0] + exitOffsetY;
+        dirX[0] = -dirUponTurnEntry[0];
+        dirY[0] = 0;
+
+        distanceRemaining -= distRemainingInTurn;
+
+        turning[0] = false;
+
+        // In analytic mode, the head looks for its next turn from
+        // here, on the new row and heading the other way.  Otherwise
+        // (as in the original game) it only looks on the next tick,
+        // so a head that is fast enough to turn twice in one tick
+        // takes the second turn in the wrong place.
+
+        if (worldConfig.analyticMotion && distanceRemaining > 0)
+        {
+          turningPositionX = nextTurningPositionX(segs);
+          dir = signum(dirX[0]);
         }
       }
     }
+  }
+
+  // Place the body segments along the path.  Segment i lies between
+  // samples 'newest - i * PATH_SAMPLES_PER_SEG' and the one after, at
+  // the same fraction 't' of the way as the head is past 'newest'.
 
-    // The segment passes to the *next* segment (i.e. the next
-    // iteration of this loop) the position at which it started
-    // turning (or MAXFLOAT if it did not start turning).  In the next
-    // loop iteration, the next segment will check this
-    // turningPositionX.
+  float t = (path.headArc - path.newest * PATH_SAMPLE_SPACING) / PATH_SAMPLE_SPACING;
 
-    turningPositionX = segments[i]->turningPositionX;
+  for (int i = 1; i < numSegs; i++)
+  {
+    PathPoint &a = path[path.newest - i * PATH_SAMPLES_PER_SEG];
+    PathPoint &b = path[path.newest - i * PATH_SAMPLES_PER_SEG + 1];
+
+    posX[i] = a.x + t * (b.x - a.x);
+    posY[i] = a.y + t * (b.y - a.y);
+    dirX[i] = a.dirX + t * (b.dirX - a.dirX);
+    dirY[i] = a.dirY + t * (b.dirY - a.dirY);
   }
 
   // Update centipede's phase
@@ -205,7 +467,72 @@ void Centipede::updatePose(float elapsedTime)
   phase += distanceToTravel / legTravelPerCycle;
 }
 
-void Segment::draw(bool isHead, float phase, mat4 &worldToViewTransform)
+// Split off segments 'firstSeg' onward (firstSeg > 0) as a new
+// centipede.  The new centipede gets the part of the path under its
+// segments, and its head takes over the turn state that the old head
+// had at that point of the path.  (The caller shortens this
+// centipede.)
+
+Centipede Centipede::tail(int firstSeg, SegmentStore &segs)
+
+{
+  Centipede tail(first + firstSeg, numSegs - firstSeg);
+
+  tail.random.seed(random.next());
+
+  long offset = (long)firstSeg * PATH_SAMPLES_PER_SEG;
+
+  tail.path.init(tail.numSegs);
+  tail.path.newest = path.newest - offset;
+  tail.path.headArc = path.headArc - offset * PATH_SAMPLE_SPACING;
+
+  for (long n = tail.path.newest - (long)(tail.numSegs - 1) * PATH_SAMPLES_PER_SEG; n <= tail.path.newest; n++)
+    tail.path[n] = path[n];
+
+  // The head's turn state, from the samples on either side of it.
+  // 'u' is how far it is past the earlier one.
+
+  PathPoint &a = path[tail.path.newest];
+  PathPoint &b = path[tail.path.newest + 1];
+
+  double u = tail.path.headArc - tail.path.newest * PATH_SAMPLE_SPACING;
+  double radius = CENTIPEDE_TURN_RADIUS;
+
+  int h = tail.first;
+
+  const PathPoint *turn = NULL;
+  double angle = 0;
+
+  if (a.turning && a.turnAngle + u / radius < M_PI)
+  {
+    turn = &a; // in the turn that 'a' is in
+    angle = a.turnAngle + u / radius;
+  }
+  else if (b.turning && b.turnAngle - (PATH_SAMPLE_SPACING - u) / radius >= 0)
+  {
+    turn = &b; // in the turn that 'b' is in
+    angle = b.turnAngle - (PATH_SAMPLE_SPACING - u) / radius;
+  }
+
+  if (turn)
+  {
+    segs.turning[h] = true;
+    segs.turnAngle[h] = angle;
+    segs.turnCentreX[h] = turn->turnCentreX;
+    segs.turnCentreY[h] = turn->turnCentreY;
+    segs.dirUponTurnEntry[h] = turn->dirUponTurnEntry;
+    segs.turnDir[h] = turn->turnDir;
+  }
+  else
+  {
+    segs.turning[h] = false;
+    segs.turnDir[h] = b.turnDir;
+  }
+
+  return tail;
+}
+
+void Segment::draw(vec2 pos, vec2 dir, bool isHead, float phase, mat4 &worldToViewTransform)
 
 {
   // Move phase into range [0,1]
@@ -233,227 +560,248 @@ void Segment::draw(bool isHead, float phase, mat4 &worldToViewTransform)
     bodySegParams[phaseIndex].draw();
 };
 
-void Segment::generateVAOs()
+// The geometry of one drawing of a segment.  It's built on any
+// thread, then copied to a VBO on the main thread.
 
+struct SegmentMesh
 {
-  int numPhases = ceil(1.0 / PHASE_RESOLUTION);
-
-  // Find line width 'lw' in world coordinate system
+  seq<vec2> positions;
+  seq<vec3> colours;
+  DrawBuffers db;
+};
 
-  int width, height;
-  glfwGetFramebufferSize(window, &width, &height);
-  float lw = LINE_HALFWIDTH_IN_PIXELS / (float)height * 2; // relies on top-bottom = 2 in WCS
+// Build a head or body segment with its legs at phase 'phaseIndex' of
+// 'numPhases', drawing lines 'lw' wide.  This makes no GL calls.
 
-  // Build the segments
+static void buildSegmentMesh(bool isHead, int phaseIndex, int numPhases, float lw, SegmentMesh &mesh)
 
-  for (int isHead = 0; isHead < 2; isHead++) // treat 'isHead' as a boolean using values 0 and 1
-
-    for (int phaseIndex = 0; phaseIndex < numPhases; phaseIndex++)
-    { // each phase has a slightly different positioning of the legs
+{
+  // Since we don't know beforehand how many vertices there are, fill
+  // in these 'positions' and 'colours'.  They're copied to the VBO
+  // later.
 
-      // Start setting up a VAO
+  seq<vec2> &positions = mesh.positions;
+  seq<vec3> &colours = mesh.colours;
+  DrawBuffers &db = mesh.db;
 
-      GLuint VAO;
-      glGenVertexArrays(1, &VAO);
-      glBindVertexArray(VAO);
+  GLuint offset; // offset to first vertex of the current piece of geometry
 
-      // Define the VBO
+  // ---- Build the body circle with a triangle fan ----
 
-      GLuint VBO;
-      glGenBuffers(1, &VBO);
-      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  offset = positions.size();
 
-      // Define the attributes
+  positions.add(vec2(0, 0));
 
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0); // two floats for a position
-      glEnableVertexAttribArray(0);
+  for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
+    positions.add(vec2(SEG_BODY_RADIUS * cos(theta), SEG_BODY_RADIUS * sin(theta)));
 
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float))); // three floats for a colour
-      glEnableVertexAttribArray(1);
+  positions.add(positions[offset + 1]); // add the first one again to close the circle ... just in case
 
-      // Stop setting up this VAO.
+  // set the same colour for each vertex
 
-      glBindVertexArray(0);
+  for (int i = offset; i < positions.size(); i++)
+    colours.add(SEG_BODY_COLOUR);
 
-      // ---------------- Set up the geometry ----------------
+  // Add this geometry to the DrawBuffers structure
 
-      DrawBuffers db(VAO);
+  db.mode.add(GL_TRIANGLE_FAN);
+  db.first.add(offset);
+  db.count.add(positions.size() - offset);
 
-      // Since we don't know beforehand how many vertices there are,
-      // fill in these 'positions' and 'colours'.  Once done, copy them
-      // to the VBO.
+  // ---- Build a halo around the body circle with a triangle strip ----
 
-      seq<vec2> positions;
-      seq<vec3> colours;
+  offset = positions.size();
 
-      GLuint offset; // offset to first vertex of the current piece of geometry
+  for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
+  {
+    positions.add(vec2(SEG_BODY_RADIUS * cos(theta), SEG_BODY_RADIUS * sin(theta)));
+    positions.add(vec2(SEG_HALO_RADIUS * cos(theta), SEG_HALO_RADIUS * sin(theta)));
+  }
 
-      // ---- Build the body circle with a triangle fan ----
+  positions.add(positions[offset]);
+  positions.add(positions[offset + 1]);
 
-      offset = positions.size();
+  // set the same colour for each vertex
 
-      positions.add(vec2(0, 0));
+  for (int i = offset; i < positions.size(); i++)
+    colours.add(SEG_HALO_COLOUR);
 
-      for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
-        positions.add(vec2(SEG_BODY_RADIUS * cos(theta), SEG_BODY_RADIUS * sin(theta)));
+  // Add this geometry to the DrawBuffers structure
 
-      positions.add(positions[offset + 1]); // add the first one again to close the circle ... just in case
+  db.mode.add(GL_TRIANGLE_STRIP);
+  db.first.add(offset);
+  db.count.add(positions.size() - offset);
 
-      // set the same colour for each vertex
+  // ---- Build the legs with lines ----
 
-      for (int i = offset; i < positions.size(); i++)
-        colours.add(SEG_BODY_COLOUR);
+  offset = positions.size();
 
-      // Add this geometry to the DrawBuffers structure
+  // The phaseIndex determines the leg orientation, which varies
+  // linearly in [ SEG_LEG_THETA0, SEG_LEG_THETA1 ].
 
-      db.mode.add(GL_TRIANGLE_FAN);
-      db.first.add(offset);
-      db.count.add(positions.size() - offset);
+  float legPhase = sin(phaseIndex / (float)numPhases * 2 * M_PI); // varies in [-1,1)
 
-      // ---- Build a halo around the body circle with a triangle strip ----
+  float legAngle = 0.5 * (SEG_LEG_THETA0 + SEG_LEG_THETA1) + legPhase * 0.5 * (SEG_LEG_THETA1 - SEG_LEG_THETA0);
 
-      offset = positions.size();
+  // left leg
 
-      for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
-      {
-        positions.add(vec2(SEG_BODY_RADIUS * cos(theta), SEG_BODY_RADIUS * sin(theta)));
-        positions.add(vec2(SEG_HALO_RADIUS * cos(theta), SEG_HALO_RADIUS * sin(theta)));
-      }
+  vec2 innerLeft(0.9 * SEG_BODY_RADIUS * cos(legAngle), 0.9 * SEG_BODY_RADIUS * sin(legAngle));
+  vec2 outerLeft(SEG_LEG_LENGTH * cos(legAngle), SEG_LEG_LENGTH * sin(legAngle));
 
-      positions.add(positions[offset]);
-      positions.add(positions[offset + 1]);
+  vec2 perpLeft(-lw * sin(legAngle), lw * cos(legAngle));
 
-      // set the same colour for each vertex
+  positions.add(innerLeft + perpLeft);
+  positions.add(innerLeft - perpLeft);
 
-      for (int i = offset; i < positions.size(); i++)
-        colours.add(SEG_HALO_COLOUR);
+  positions.add(outerLeft + perpLeft);
+  positions.add(outerLeft - perpLeft);
 
-      // Add this geometry to the DrawBuffers structure
+  // set the same colour for each vertex
 
-      db.mode.add(GL_TRIANGLE_STRIP);
-      db.first.add(offset);
-      db.count.add(positions.size() - offset);
+  for (int i = offset; i < positions.size(); i++)
+    colours.add(SEG_LEG_COLOUR);
 
-      // ---- Build the legs with lines ----
+  // Add this geometry to the DrawBuffers structure
 
-      offset = positions.size();
+  db.mode.add(GL_TRIANGLE_STRIP);
+  db.first.add(offset);
+  db.count.add(positions.size() - offset);
 
-      // The phaseIndex determines the leg orientation, which varies
-      // linearly in [ SEG_LEG_THETA0, SEG_LEG_THETA1 ].
+  // right leg
 
-      float legPhase = sin(phaseIndex / (float)numPhases * 2 * M_PI); // varies in [-1,1)
+  offset = positions.size();
 
-      float legAngle = 0.5 * (SEG_LEG_THETA0 + SEG_LEG_THETA1) + legPhase * 0.5 * (SEG_LEG_THETA1 - SEG_LEG_THETA0);
+  vec2 innerRight(0.9 * SEG_BODY_RADIUS * cos(-legAngle), 0.9 * SEG_BODY_RADIUS * sin(-legAngle));
+  vec2 outerRight(SEG_LEG_LENGTH * cos(-legAngle), SEG_LEG_LENGTH * sin(-legAngle));
 
-      // left leg
+  vec2 perpRight(-lw * sin(-legAngle), lw * cos(-legAngle));
 
-      vec2 innerLeft(0.9 * SEG_BODY_RADIUS * cos(legAngle), 0.9 * SEG_BODY_RADIUS * sin(legAngle));
-      vec2 outerLeft(SEG_LEG_LENGTH * cos(legAngle), SEG_LEG_LENGTH * sin(legAngle));
+  positions.add(innerRight + perpRight);
+  positions.add(innerRight - perpRight);
 
-      vec2 perpLeft(-lw * sin(legAngle), lw * cos(legAngle));
+  positions.add(outerRight + perpRight);
+  positions.add(outerRight - perpRight);
 
-      positions.add(innerLeft + perpLeft);
-      positions.add(innerLeft - perpLeft);
+  // set the same colour for each vertex
 
-      positions.add(outerLeft + perpLeft);
-      positions.add(outerLeft - perpLeft);
+  for (int i = offset; i < positions.size(); i++)
+    colours.add(SEG_LEG_COLOUR);
 
-      // set the same colour for each vertex
+  // Add this geometry to the DrawBuffers structure
 
-      for (int i = offset; i < positions.size(); i++)
-        colours.add(SEG_LEG_COLOUR);
+  db.mode.add(GL_TRIANGLE_STRIP);
+  db.first.add(offset);
+  db.count.add(positions.size() - offset);
 
-      // Add this geometry to the DrawBuffers structure
+  // ---- For a head, add oval eyes ----
 
-      db.mode.add(GL_TRIANGLE_STRIP);
-      db.first.add(offset);
-      db.count.add(positions.size() - offset);
+  if (isHead)
 
-      // right leg
+    for (int i = 0; i < 2; i++)
+    { // two eyes
 
       offset = positions.size();
 
-      vec2 innerRight(0.9 * SEG_BODY_RADIUS * cos(-legAngle), 0.9 * SEG_BODY_RADIUS * sin(-legAngle));
-      vec2 outerRight(SEG_LEG_LENGTH * cos(-legAngle), SEG_LEG_LENGTH * sin(-legAngle));
+      float theta = SEG_EYE_ANGLE * (i * 2 - 1); // -angle on one iteration, +angle on other iteration
 
-      vec2 perpRight(-lw * sin(-legAngle), lw * cos(-legAngle));
+      vec2 eyeCentre(SEG_EYE_DISTANCE * cos(theta), SEG_EYE_DISTANCE * sin(theta));
+      vec2 eyeXDir = eyeCentre.normalize();
+      vec2 eyeYDir = vec2(-eyeXDir.y, eyeXDir.x);
 
-      positions.add(innerRight + perpRight);
-      positions.add(innerRight - perpRight);
+      positions.add(eyeCentre);
 
-      positions.add(outerRight + perpRight);
-      positions.add(outerRight - perpRight);
+      for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
+        positions.add(eyeCentre + (SEG_EYE_X_RADIUS * cos(theta)) * eyeXDir + (SEG_EYE_Y_RADIUS * sin(theta)) * eyeYDir);
+
+      positions.add(positions[offset + 1]);
 
       // set the same colour for each vertex
 
       for (int i = offset; i < positions.size(); i++)
-        colours.add(SEG_LEG_COLOUR);
+        colours.add(SEG_EYE_COLOUR);
 
       // Add this geometry to the DrawBuffers structure
 
-      db.mode.add(GL_TRIANGLE_STRIP);
+      db.mode.add(GL_TRIANGLE_FAN);
       db.first.add(offset);
       db.count.add(positions.size() - offset);
+    }
+}
 
-      // ---- For a head, add oval eyes ----
+// The meshes of the different phases are built in parallel on the
+// job pool.  Only the GL calls that set up each VAO and fill its VBO
+// run on this thread, which owns the GL context.
 
-      if (isHead)
+void Segment::generateVAOs()
 
-        for (int i = 0; i < 2; i++)
-        { // two eyes
+{
+  int numPhases = ceil(1.0 / PHASE_RESOLUTION);
 
-          offset = positions.size();
+  // Find line width 'lw' in world coordinate system
 
-          float theta = SEG_EYE_ANGLE * (i * 2 - 1); // -angle on one iteration, +angle on other iteration
+  int width, height;
+  glfwGetFramebufferSize(window, &width, &height);
+  float lw = LINE_HALFWIDTH_IN_PIXELS / (float)height * 2; // relies on top-bottom = 2 in WCS
 
-          vec2 eyeCentre(SEG_EYE_DISTANCE * cos(theta), SEG_EYE_DISTANCE * sin(theta));
-          vec2 eyeXDir = eyeCentre.normalize();
-          vec2 eyeYDir = vec2(-eyeXDir.y, eyeXDir.x);
+  // Build the segments
 
-          positions.add(eyeCentre);
+  SegmentMesh *meshes = new SegmentMesh[2 * numPhases];
+  JobGraph graph;
 
-          for (float theta = 0; theta < 2 * M_PI; theta += 2 * M_PI / (float)PIECES_PER_CIRCLE)
-            positions.add(eyeCentre + (SEG_EYE_X_RADIUS * cos(theta)) * eyeXDir + (SEG_EYE_Y_RADIUS * sin(theta)) * eyeYDir);
+  for (int isHead = 0; isHead < 2; isHead++) // treat 'isHead' as a boolean using values 0 and 1
 
-          positions.add(positions[offset + 1]);
+    for (int phaseIndex = 0; phaseIndex < numPhases; phaseIndex++)
+    { // each phase has a slightly different positioning of the legs
 
-          // set the same colour for each vertex
+      SegmentMesh &mesh = meshes[isHead * numPhases + phaseIndex];
 
-          for (int i = offset; i < positions.size(); i++)
-            colours.add(SEG_EYE_COLOUR);
+      int build = graph.add("segment mesh", [=, &mesh]() {
+        buildSegmentMesh(isHead, phaseIndex, numPhases, lw, mesh);
+      });
 
-          // Add this geometry to the DrawBuffers structure
+      int upload = graph.addOnMainThread("segment upload", [&mesh]() {
 
-          db.mode.add(GL_TRIANGLE_FAN);
-          db.first.add(offset);
-          db.count.add(positions.size() - offset);
-        }
+        // Set up a VAO
 
-      // ---------------- Copy positions and colours to the VBO ----------------
+        GLuint VAO;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
 
-      int numFloats = positions.size() * (2 + 3);
+        // Define the VBO
 
-      float *buffer = new float[numFloats];
+        GLuint VBO;
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-      float *p = buffer;
-      for (int i = 0; i < positions.size(); i++)
-      {
-        *p++ = positions[i].x;
-        *p++ = positions[i].y;
-        *p++ = colours[i].x;
-        *p++ = colours[i].y;
-        *p++ = colours[i].z;
-      }
+        // Define the attributes
 
-      glBufferData(GL_ARRAY_BUFFER, numFloats * sizeof(float), buffer, GL_STATIC_DRAW);
+        setupPackedVertexAttribs(); // position and palette index
 
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
 
-      // Add to the DrawBuffers
+        // Copy positions and colours to the VBO
 
-      if (isHead)
-        headSegParams.add(db);
-      else
-        bodySegParams.add(db);
+        uploadInterleaved(VBO, mesh.positions, mesh.colours);
+
+        mesh.db.VAO = VAO;
+      });
+
+      graph.depends(upload, build);
     }
+
+  jobPool().run(graph);
+
+  // Move the meshes' DrawBuffers in, rather than copying their
+  // sequences
+
+  bodySegParams.reserve(bodySegParams.size() + numPhases);
+  headSegParams.reserve(headSegParams.size() + numPhases);
+
+  for (int phaseIndex = 0; phaseIndex < numPhases; phaseIndex++)
+  {
+    bodySegParams.add(std::move(meshes[phaseIndex].db));
+    headSegParams.add(std::move(meshes[numPhases + phaseIndex].db));
+  }
+
+  delete[] meshes;
 }
@@ -9,11 +9,14 @@
 #include "drawbuffer.h"
 #include "seq.h"
 #include "worldDefs.h"
+#include "pool.h"
+
+#include <stdint.h>
 
 #define PHASE_DELTA_PER_SEG 0.1
 #define PHASE_RESOLUTION 0.05
 
-#define SEG_BODY_RADIUS  (0.25 * ROW_SPACING)
+#define SEG_BODY_RADIUS  (0.25 * worldConfig.rowSpacing)
 #define SEG_HALO_RADIUS  (1.2 * SEG_BODY_RADIUS) 
 #define SEG_LEG_LENGTH   (1.6 * SEG_BODY_RADIUS)   // distance from body centre to tip of leg
 #define SEG_SEG_DISTANCE (1.8 * SEG_BODY_RADIUS) 
@@ -31,81 +34,220 @@
 #define SEG_LEG_THETA0  ( 70.0 * M_PI/180.0) // range of angles that legs move through
 #define SEG_LEG_THETA1  (125.0 * M_PI/180.0) //   for left side.  right side is mirrored.
 
-#define CENTIPEDE_TURN_RADIUS (0.5 * ROW_SPACING)
+#define CENTIPEDE_TURN_RADIUS (0.5 * worldConfig.rowSpacing)
 
+#define SEGMENT_HOLE_Y (-MAXFLOAT) // posY of a hole in the SegmentStore: never ahead of a dart
 
-class Segment {
+#define PATH_SAMPLES_PER_SEG 4 // samples of the head's path between adjacent segments
+#define PATH_SAMPLE_SPACING  (SEG_SEG_DISTANCE / PATH_SAMPLES_PER_SEG)
 
-  friend class Centipede;
-  friend class World;
 
-  // state
+// Drawing of one segment.  The segments' state is in a SegmentStore.
+
+class Segment {
+
+  // VAOs for drawing ("static", so these are shared by all segments)
   
-  vec2 pos;
-  vec2 dir;
+  static seq<DrawBuffers> headSegParams;
+  static seq<DrawBuffers> bodySegParams;
+
+ public:
+
+  static void generateVAOs();
+
+  static void draw( vec2 pos, vec2 dir, bool isHead, float phase, mat4 &worldToViewTransform );
+};
+
+
+// The state of all the segments of all the centipedes, as a structure
+// of arrays, so that a pass over the segments (in updatePose and in
+// World::updateSegmentGrid) streams through contiguous memory.
+//
+// Only a head moves by itself, so the turn state is only kept up to
+// date for heads.  Body segments just have a position and direction,
+// which come from the head's path (see CentipedePath).
+//
+// Each centipede owns a span of the store, head first.  When a
+// centipede is split, the hit segment is left in place as a hole
+// (counted in 'numHoles') and the spans on either side of it become
+// the two centipedes.  World::compactSegments() squeezes out the
+// holes.
+
+class SegmentStore {
+
+ public:
+
+  seq<float> posX, posY;
+  seq<float> dirX, dirY;
+  seq<float> prevX, prevY;      // position at the start of the step (see savePositions)
+
+  seq<bool>  turning;
+  seq<float> turnAngle;
+  seq<float> turnCentreX, turnCentreY;
+  seq<float> dirUponTurnEntry;
+  seq<int>   turnDir;
+
+  int numHoles;
+
+  SegmentStore() { numHoles = 0; }
+
+  int size() const { return posX.size(); }
+
+  vec2 pos( int i ) const { return vec2( posX[i], posY[i] ); }
+  vec2 dir( int i ) const { return vec2( dirX[i], dirY[i] ); }
+
+  int add( vec2 pos, vec2 dir ); // returns the new segment's index
+  void move( int to, int from );
+  void truncate( int n );        // keep only the first n segments
+  void savePositions();         // copy pos to prev, for the continuous dart test
+  void makeHole( int i ) {      // (see segmentsweep.h)
+    posY[i] = SEGMENT_HOLE_Y;
+    numHoles++;
+  }
+  void clear();
+};
+
+
+// A point on the path of a centipede's head, with the head's turn
+// state there, so that a body segment can take over as a head when
+// the centipede is split.
+
+struct PathPoint {
+  float x, y;
+  float dirX, dirY;
 
   bool  turning;
   float turnAngle;
-  vec2  turnCentre;
-  float turningPositionX;
+  float turnCentreX, turnCentreY;
   float dirUponTurnEntry;
   int   turnDir;
+};
 
-  // VAOs for drawing ("static", so these are shared by all Segment instances)
-  
-  static seq<DrawBuffers> headSegParams;
-  static seq<DrawBuffers> bodySegParams;
+
+// The recent path of a centipede's head, parameterised by arc length.
+//
+// Sample n is the head's position at arc length n * PATH_SAMPLE_SPACING
+// along its path.  The samples are kept in a ring buffer that holds
+// enough of them to reach back to the tail, and older ones are
+// overwritten.
+//
+// Segment i is SEG_SEG_DISTANCE * i behind the head along the path,
+// which is exactly PATH_SAMPLES_PER_SEG * i samples behind it.  So
+// every body segment lies the same fraction of the way between the
+// same pair of samples, relative to itself, and placing the body is
+// one interpolation per segment.
+//
+// The rings come from a pool (see pool.h), and a copy of a path shares
+// its ring.  A centipede's ring goes back to the pool when the World
+// removes the centipede (see World::removeCentipede).
+
+class CentipedePath {
+
+  static PowerOfTwoPool<PathPoint> ringPool;
+
+  PathPoint *ring;
+  long mask;                    // ring size - 1 (a power of two)
+
+  static long ringSize( int numSegs );
 
  public:
 
-  Segment( vec2 _pos, vec2 _dir ) {
+  double headArc;               // arc length of the head along the path
+  long newest;                  // the newest sample, at or behind the head
+
+  CentipedePath() { ring = NULL; mask = 0; headArc = 0; newest = 0; }
 
-    pos = _pos;
-    dir = _dir;
-    turning = false;
-    turningPositionX = MAXFLOAT;
+  void init( int numSegs );     // make room for the samples of 'numSegs' segments
+  void release();               // give the ring back to the pool
 
-    // For the first segment ever created, set up the VAOs
-    
-    if (headSegParams.size() == 0)
-      generateVAOs();
+  static void reserve( int numSegs, int count ); // have rings ready for 'count' centipedes of 'numSegs' segments
+
+  PathPoint & operator [] ( long n ) { return ring[ n & mask ]; }
+
+  void add( const PathPoint &p ) {
+    newest++;
+    (*this)[newest] = p;
   }
 
-  void generateVAOs();
+  // Skip the samples that would be overwritten before the head gets
+  // to 'arc', so that a long step costs no more than the ring size
 
-  void draw( bool isHead, float phase, mat4 &worldToViewTransform );
+  void skipTo( double arc ) {
+    long n = (long) floor( arc / PATH_SAMPLE_SPACING ) - (mask + 1);
+    if (newest < n)
+      newest = n;
+  }
 };
 
 
+// A centipede's own random numbers (xorshift32), so that the result
+// of updating the centipedes doesn't depend on the order in which
+// they're updated, or on how they're split among threads
+
+class RandomStream {
+
+  uint32_t state;
+
+ public:
+
+  RandomStream() { seed( 1 ); }
+
+  void seed( uint32_t s ) {
+    s = (s ^ 61) ^ (s >> 16);   // spread the bits of a small seed
+    s *= 9;
+    s ^= s >> 4;
+    s *= 0x27d4eb2d;
+    s ^= s >> 15;
+    state = (s ? s : 1);        // xorshift never leaves 0
+  }
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  float in01() { return (next() >> 8) * (1.0f / (1 << 24)); } // in [0,1)
+};
+
 
 class Centipede {
 
+  friend class World;
+
   float phase = 0; // in [0,1] for the phase of the centipede's leg movement
 
- public:
+  CentipedePath path;
 
-  seq<Segment*> segments;
+  RandomStream random; // for the turns in the player area
 
-  Centipede( int numSegs, vec2 headPos, vec2 dir ) {
+  float nextTurningPositionX( SegmentStore &segs );
 
-    // Set up segments with head at headPos, and each other segment in
-    // the -dir direction from the head, with 'SEG_SEG_DISTANCE' spacing
-    // so that they overlap a bit.
-    
-    for (int i=0; i<numSegs; i++)
-      segments.add( new Segment( headPos - i * SEG_SEG_DISTANCE * dir, dir ) );
-  };
+  void recordStraight( vec2 from, vec2 dir, float length, int turnDir );
+  void recordTurn( PathPoint turn, float fromAngle, float length );
+
+ public:
 
+  int first;   // index of the head in the SegmentStore
+  int numSegs;
 
-  void draw( mat4 &worldToViewTransform ) {
+  Centipede() {}
 
-    for (int i=0; i<segments.size(); i++)
-      segments[i]->draw( (i==0), // first argument to draw() is true for the head segment only
-			 phase - i*PHASE_DELTA_PER_SEG, // phase varies with segment to make legs ripple
-			 worldToViewTransform );
+  Centipede( int _first, int _numSegs ) { // an existing span of segments
+    first = _first;
+    numSegs = _numSegs;
   }
 
-  void updatePose( float elapsedTime );
+  Centipede( SegmentStore &segs, int numSegs, vec2 headPos, vec2 dir );
+
+  void updatePose( float elapsedTime, SegmentStore &segs );
+
+  Centipede tail( int firstSeg, SegmentStore &segs ); // segments firstSeg onward, as a new centipede
+
+  void release() { path.release(); } // before the centipede is removed
+
+  static void reservePaths( int numSegs, int count ) { CentipedePath::reserve( numSegs, count ); }
 };
 
 
@@ -3,6 +3,7 @@
 
 #include "dart.h"
 #include "main.h"
+#include "vertexformat.h"
 #include "worldDefs.h"
 
 
@@ -10,7 +11,7 @@
 
 #define DART_GEOM_COUNT 4
 
-#define DART_GEOM_SCALE  (0.6 * ROW_SPACING)
+#define DART_GEOM_SCALE  (0.6 * worldConfig.rowSpacing)
 
 vec2 Dart::dartGeometry[DART_GEOM_COUNT] = { // dart tip is at (0,0)
   vec2(-0.10,-1),
@@ -37,11 +38,7 @@ void Dart::generateVAOs()
 
   // Define the attributes
 
-  glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ); // two floats for a position
-  glEnableVertexAttribArray( 0 );
-
-  glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*) (2*sizeof(float)) ); // three floats for a colour
-  glEnableVertexAttribArray( 1 );
+  setupPackedVertexAttribs(); // position and palette index
 
   // Stop setting up this VAO.
 
@@ -80,27 +77,12 @@ void Dart::generateVAOs()
 
   // ---------------- Copy positions and colours to the VBO ----------------
 
-  int numFloats = positions.size() * (2+3);
-
-  float *buffer = new float[ numFloats ];
-
-  float *p = buffer;
-  for (int i=0; i<positions.size(); i++) {
-    *p++ = positions[i].x;
-    *p++ = positions[i].y;
-    *p++ = colours[i].x;
-    *p++ = colours[i].y;
-    *p++ = colours[i].z;
-  }
-
-  glBufferData( GL_ARRAY_BUFFER, numFloats*sizeof(float), buffer, GL_STATIC_DRAW );
-      
-  glBindBuffer( GL_ARRAY_BUFFER, 0 );
+  uploadInterleaved( VBO, positions, colours );
 }
 
 
 
-void Dart::draw( mat4 &worldToViewTransform )
+void Dart::draw( vec2 pos, mat4 &worldToViewTransform )
 
 {
   // Provide MVP to GPU program
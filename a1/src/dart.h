@@ -8,9 +8,6 @@
 
 #define DART_COLOUR   vec3( 1.000, 0.300, 0.300 )
 
-#define DART_SPEED    4.0
-
-
 class Dart {
 
   static DrawBuffers *db;
@@ -20,14 +17,12 @@ class Dart {
 
   vec2 pos; // position
 
-  Dart( vec2 _pos ) {
+  Dart() {}
 
+  Dart( vec2 _pos ) {
     pos = _pos;
-
-    if (db == NULL)
-      generateVAOs();
   }
 
-  void generateVAOs();
-  void draw( mat4 &worldToViewTransform );
+  static void generateVAOs();
+  static void draw( vec2 pos, mat4 &worldToViewTransform );
 };
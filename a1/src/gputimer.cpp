@@ -0,0 +1,167 @@
+// gputimer.cpp
+//
+// See gputimer.h.  Nothing in here is compiled unless PROFILE is
+// defined.
+
+
+#ifdef PROFILE
+
+#include "gputimer.h"
+
+#define GL_GPU_DISJOINT_EXT 0x8FBB // from GL_EXT_disjoint_timer_query
+
+
+GPUTimer gpuTimer;
+
+const char *GPUTimer::passNames[ NUM_GPU_PASSES ] = {
+  "clear",
+  "mushrooms",
+  "centipedes",
+  "actors",
+  "hud"
+};
+
+
+static bool hasExtension( const char *name )
+
+{
+  GLint n = 0;
+  glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+
+  for (int i=0; i<n; i++) {
+    const char *ext = (const char *) glGetStringi( GL_EXTENSIONS, i );
+    if (ext && strcmp( ext, name ) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+
+// Choose the timing mode for the current context.  Must be called
+// with the GL context current.
+
+void GPUTimer::init()
+
+{
+  const char *version = (const char *) glGetString( GL_VERSION );
+  bool isES = (version && strncmp( version, "OpenGL ES", 9 ) == 0);
+
+  checkDisjoint = false;
+
+  if (isES)
+    checkDisjoint = hasExtension( "GL_EXT_disjoint_timer_query" );
+
+  if (checkDisjoint || (!isES && (GLVersion.major > 3 || (GLVersion.major == 3 && GLVersion.minor >= 3))) || hasExtension( "GL_ARB_timer_query" ))
+    mode = GPU_TIMING_QUERIES;
+  else
+    mode = GPU_TIMING_FINISH;
+
+  if (mode == GPU_TIMING_QUERIES) {
+    glGenQueries( 2 * NUM_GPU_PASSES, &queries[0][0] );
+    cout << "GPU timing with timer queries" << endl;
+  }
+  else
+    cout << "GPU timing: no timer queries on this context, so passes are bracketed with glFinish()" << endl;
+
+  for (int s=0; s<2; s++)
+    for (int p=0; p<NUM_GPU_PASSES; p++)
+      issued[s][p] = false;
+
+  current = 0;
+  frameStart[0] = frameStart[1] = profileClock();
+
+  lane = profilerRegisterLane( "gpu" );
+}
+
+
+void GPUTimer::beginPass( GPUPass pass )
+
+{
+  if (mode == GPU_TIMING_QUERIES) {
+
+    if (pass == 0)
+      frameStart[ current ] = profileClock();
+
+    glBeginQuery( GL_TIME_ELAPSED, queries[ current ][ pass ] );
+    issued[ current ][ pass ] = true;
+  }
+  else if (mode == GPU_TIMING_FINISH) {
+
+    glFinish();
+    finishStart = profileClock();
+  }
+}
+
+
+void GPUTimer::endPass( GPUPass pass )
+
+{
+  if (mode == GPU_TIMING_QUERIES)
+
+    glEndQuery( GL_TIME_ELAPSED );
+
+  else if (mode == GPU_TIMING_FINISH) {
+
+    glFinish();
+    profilerAddSpan( lane, passNames[ pass ], "gpu", finishStart, profileClock() );
+  }
+}
+
+
+// Read the previous frame's queries (if ready) and swap query sets
+
+void GPUTimer::endFrame()
+
+{
+  if (mode != GPU_TIMING_QUERIES)
+    return;
+
+  current = 1 - current;
+
+  readBack( current );
+}
+
+
+// Read back query set 'set' if all of its results are available.
+// Otherwise drop them rather than wait.  The GPU reports only
+// durations, so the spans are laid end to end from the time at which
+// the set was begun on the CPU.
+
+void GPUTimer::readBack( int set )
+
+{
+  bool allAvailable = true;
+
+  for (int p=0; p<NUM_GPU_PASSES; p++)
+    if (issued[set][p]) {
+      GLuint available = 0;
+      glGetQueryObjectuiv( queries[set][p], GL_QUERY_RESULT_AVAILABLE, &available );
+      if (!available)
+        allAvailable = false;
+    }
+
+  if (checkDisjoint) {
+    GLint disjoint = 0;
+    glGetIntegerv( GL_GPU_DISJOINT_EXT, &disjoint ); // also clears the flag
+    if (disjoint)
+      allAvailable = false;
+  }
+
+  ProfileTime t = frameStart[set];
+
+  for (int p=0; p<NUM_GPU_PASSES; p++)
+    if (issued[set][p]) {
+
+      if (allAvailable) {
+        GLuint ns = 0;
+        glGetQueryObjectuiv( queries[set][p], GL_QUERY_RESULT, &ns );
+        profilerAddSpan( lane, passNames[p], "gpu", t, t + ns );
+        t += ns;
+      }
+
+      issued[set][p] = false;
+    }
+}
+
+#endif
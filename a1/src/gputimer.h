@@ -0,0 +1,87 @@
+// gputimer.h
+//
+// Times the renderer's passes on the GPU and feeds the results to the
+// profiler (as a "gpu" lane in the overlay and the trace).
+//
+// GL timer queries (GL_TIME_ELAPSED) are used when the context has
+// them: desktop GL 3.3, or GL_EXT_disjoint_timer_query on GL ES.
+// Queries are double-buffered: results for a frame are read back
+// during the next frame, and only if they are already available, so
+// the CPU never waits for the GPU.  Without timer queries, each pass
+// is instead bracketed by glFinish() and timed on the CPU, which
+// stalls the pipeline but still separates GPU cost by pass.
+//
+// GPU timing is off unless enabled (with -gputime) and, like the rest
+// of the profiler, is only compiled in a PROFILE build.  Otherwise the
+// GPU_PASS_* macros expand to nothing.
+
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#ifdef PROFILE
+
+#include "headers.h"
+#include "profiler.h"
+
+
+enum GPUPass {
+  GPU_PASS_CLEAR,
+  GPU_PASS_MUSHROOMS,
+  GPU_PASS_CENTIPEDES,
+  GPU_PASS_ACTORS,
+  GPU_PASS_HUD,
+  NUM_GPU_PASSES
+};
+
+
+enum GPUTimingMode {
+  GPU_TIMING_OFF,
+  GPU_TIMING_QUERIES,
+  GPU_TIMING_FINISH
+};
+
+
+class GPUTimer {
+
+  static const char *passNames[ NUM_GPU_PASSES ];
+
+  GPUTimingMode mode;
+  bool          checkDisjoint;  // true with GL_EXT_disjoint_timer_query
+
+  int lane;                     // profiler lane for the results
+
+  GLuint      queries[2][ NUM_GPU_PASSES ];
+  bool        issued[2][ NUM_GPU_PASSES ];
+  ProfileTime frameStart[2];    // CPU time at which each query set was begun
+  int         current;          // query set used by the current frame
+
+  ProfileTime finishStart;      // CPU time of the glFinish() before the current pass
+
+  void readBack( int set );
+
+ public:
+
+  GPUTimer() { mode = GPU_TIMING_OFF; }
+
+  void init();
+  void beginPass( GPUPass pass );
+  void endPass( GPUPass pass );
+  void endFrame();
+};
+
+extern GPUTimer gpuTimer;
+
+#define GPU_PASS_BEGIN(pass) gpuTimer.beginPass( pass )
+#define GPU_PASS_END(pass)   gpuTimer.endPass( pass )
+#define GPU_FRAME_END()      gpuTimer.endFrame()
+
+#else
+
+#define GPU_PASS_BEGIN(pass)
+#define GPU_PASS_END(pass)
+#define GPU_FRAME_END()
+
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+// input.cpp
+
+
+#include "input.h"
+
+#define REPLAY_HEADER "centipede-replay 1"
+
+
+static chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+
+double inputClock()
+
+{
+  return chrono::duration<double>( chrono::steady_clock::now() - startTime ).count();
+}
+
+
+// ---------------- InputRecorder ----------------
+//
+// The file is a header line, then one line per event
+//
+//     tick type x y
+//
+// and finally "end tick".
+
+
+bool InputRecorder::open( const char *filename )
+
+{
+  out.open( filename );
+
+  if (!out) {
+    cerr << "InputRecorder: Could not open " << filename << " for writing" << endl;
+    return false;
+  }
+
+  out << REPLAY_HEADER << endl;
+  out.precision( 9 );
+  return true;
+}
+
+
+void InputRecorder::record( unsigned int tick, InputEvent &e )
+
+{
+  if (out.is_open())
+    out << tick << " " << (int) e.type << " " << e.pos.x << " " << e.pos.y << "\n";
+}
+
+
+void InputRecorder::close( unsigned int finalTick )
+
+{
+  if (out.is_open()) {
+    out << "end " << finalTick << endl;
+    out.close();
+  }
+}
+
+
+// ---------------- InputReplay ----------------
+
+
+bool InputReplay::open( const char *filename )
+
+{
+  ifstream in( filename );
+
+  if (!in) {
+    cerr << "InputReplay: Could not open " << filename << endl;
+    return false;
+  }
+
+  string header;
+  getline( in, header );
+
+  if (header != REPLAY_HEADER) {
+    cerr << "InputReplay: " << filename << " is not a replay file" << endl;
+    return false;
+  }
+
+  endTick = 0;
+  next = 0;
+
+  string word;
+
+  while (in >> word) {
+
+    if (word == "end") {
+      in >> endTick;
+      break;
+    }
+
+    ReplayEvent r;
+    int type;
+
+    r.tick = atoi( word.c_str() );
+    in >> type >> r.event.pos.x >> r.event.pos.y;
+
+    if (!in) {
+      cerr << "InputReplay: Bad event after tick " << r.tick << endl;
+      break;
+    }
+
+    r.event.type = (InputType) type;
+    r.event.time = 0;
+    events.add( r );
+
+    if (r.tick > endTick)
+      endTick = r.tick;
+  }
+
+  return true;
+}
+
+
+// Return the next event if it was recorded at or before 'tick'
+
+bool InputReplay::nextEventAt( unsigned int tick, InputEvent &e )
+
+{
+  if (next == events.size() || events[next].tick > tick)
+    return false;
+
+  e = events[next++].event;
+  return true;
+}
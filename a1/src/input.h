@@ -0,0 +1,88 @@
+// input.h
+//
+// Input events passed from the window thread to the simulation
+// thread.
+//
+// The GLFW callbacks only push timestamped InputEvents onto a
+// single-producer/single-consumer ring (see spscring.h).  The
+// simulation drains the ring at the start of each tick, so input is
+// always applied at a tick boundary and in the order it arrived.
+// That makes a run reproducible from the (tick, event) pairs alone,
+// which is what the InputRecorder writes and the InputReplay reads
+// back.
+
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "headers.h"
+#include "spscring.h"
+#include "seq.h"
+#include <fstream>
+
+#define INPUT_QUEUE_SIZE 1024 // must be a power of two
+
+
+enum InputType {
+  INPUT_MOVE,                   // player moved to 'pos' (in world coordinates)
+  INPUT_FIRE,
+  INPUT_PAUSE,                  // toggle pause
+  INPUT_FASTER,
+  INPUT_SLOWER,
+  INPUT_RESTART
+};
+
+
+struct InputEvent {
+  InputType type;
+  vec2      pos;
+  double    time;               // seconds since program start at which the event arrived
+};
+
+
+// Seconds since program start
+
+double inputClock();
+
+
+typedef SPSCRing<InputEvent,INPUT_QUEUE_SIZE> InputQueue;
+
+
+// Writes each applied event with the tick at which it was applied
+
+class InputRecorder {
+
+  ofstream out;
+
+ public:
+
+  bool open( const char *filename );
+  void record( unsigned int tick, InputEvent &e );
+  void close( unsigned int finalTick );
+};
+
+
+// Reads a recording and hands back its events at the recorded ticks.
+// The whole recording is read when it's opened, so that replaying it
+// doesn't touch the file (or the heap) during play.
+
+class InputReplay {
+
+  struct ReplayEvent {
+    unsigned int tick;
+    InputEvent   event;
+  };
+
+  seq<ReplayEvent> events;
+  int next;                     // index of the next event to hand back
+
+ public:
+
+  unsigned int endTick;         // tick at which the recording stopped
+
+  bool open( const char *filename );
+  bool nextEventAt( unsigned int tick, InputEvent &e );
+  bool finished( unsigned int tick ) { return next == events.size() && tick >= endTick; }
+};
+
+#endif
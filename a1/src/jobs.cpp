@@ -0,0 +1,378 @@
+// jobs.cpp
+
+
+#include "jobs.h"
+#include "worldconfig.h"
+#include "profiler.h"
+
+
+// The pool that the current thread belongs to, and its index in that
+// pool
+
+static thread_local JobPool *currentPool = NULL;
+static thread_local int currentIndex = 0;
+
+
+JobGraph::~JobGraph()
+
+{
+  for (int i=0; i<jobs.size(); i++)
+    delete jobs[i];
+}
+
+
+int JobGraph::addJob( const char *name, const JobFunc &func, bool onMainThread )
+
+{
+  Job *job = new Job;
+
+  job->name = name;
+  job->func = func;
+  job->onMainThread = onMainThread;
+  job->numDeps = 0;
+
+  jobs.add( job );
+
+  return jobs.size()-1;
+}
+
+
+void JobGraph::depends( int job, int on )
+
+{
+  jobs[on]->successors.add( jobs[job] );
+  jobs[job]->numDeps++;
+}
+
+
+JobPool::JobPool( int numThreads )
+
+{
+  if (numThreads <= 0)
+    numThreads = std::thread::hardware_concurrency(); // 0 if unknown
+
+  numWorkers = (numThreads > 1 ? numThreads - 1 : 0);
+
+  mainThread = std::this_thread::get_id();
+  currentPool = this;
+  currentIndex = 0;
+
+  numQueued = 0;
+  quit = false;
+
+  deques = new TaskDeque[ numWorkers + 1 ];
+  workers = new std::thread[ numWorkers ];
+
+  numStarted = 0;
+
+  for (int i=0; i<numWorkers; i++)
+    workers[i] = std::thread( &JobPool::work, this, i+1 );
+
+  // Wait for the workers to start, so that whatever they allocate
+  // when they start (such as their profiler lanes) is allocated now
+  // rather than in the middle of some later tick
+
+  std::unique_lock<std::mutex> lock( sleepMutex );
+  started.wait( lock, [this]{ return numStarted == numWorkers; } );
+}
+
+
+JobPool::~JobPool()
+
+{
+  {
+    std::lock_guard<std::mutex> lock( sleepMutex );
+    quit = true;
+  }
+  wake.notify_all();
+
+  for (int i=0; i<numWorkers; i++)
+    workers[i].join();
+
+  delete [] workers;
+  delete [] deques;
+}
+
+
+// The current thread's deque.  Threads outside the pool share the
+// main thread's.
+
+int JobPool::threadIndex()
+
+{
+  return (currentPool == this ? currentIndex : 0);
+}
+
+
+// Push a task onto the back of deque 'self'.  If the deque is full,
+// run the task now instead.
+
+void JobPool::push( int self, const Task &t )
+
+{
+  TaskDeque &d = deques[self];
+
+  {
+    std::lock_guard<std::mutex> lock( d.mutex );
+
+    if (d.back - d.front < JOB_DEQUE_SIZE) {
+      d.tasks[ d.back++ & (JOB_DEQUE_SIZE-1) ] = t;
+      numQueued++;
+      return;
+    }
+  }
+
+  Task copy = t;
+  runTask( self, copy );
+}
+
+
+// Take a task from the back of our own deque, or else steal one from
+// the front of another thread's, trying the threads in turn starting
+// with the next one
+
+bool JobPool::findTask( int self, Task &t )
+
+{
+  int n = numWorkers + 1;
+
+  for (int k=0; k<n; k++) {
+
+    TaskDeque &d = deques[ (self + k) % n ];
+    std::lock_guard<std::mutex> lock( d.mutex );
+
+    if (d.front == d.back)
+      continue;
+
+    if (k == 0)
+      t = d.tasks[ --d.back & (JOB_DEQUE_SIZE-1) ];
+    else
+      t = d.tasks[ d.front++ & (JOB_DEQUE_SIZE-1) ];
+
+    numQueued--;
+    return true;
+  }
+
+  return false;
+}
+
+
+// Run a task on thread 'self'.  When a job of a graph finishes, the
+// jobs that were waiting only for it become ready.
+
+void JobPool::runTask( int self, Task &t )
+
+{
+  {
+    PROFILE_JOB_SCOPE( t.name );
+
+    if (t.job == NULL)
+      (*t.body)( t.begin, t.end );
+    else
+      t.job->func();
+  }
+
+  if (t.job != NULL) {
+
+    int numReady = 0;
+
+    for (int i=0; i<t.job->successors.size(); i++) {
+
+      JobGraph::Job *next = t.job->successors[i];
+
+      if (--next->waitingFor > 0)
+        continue;
+
+      Task nt = { next->name, NULL, 0, 0, next, t.unfinished };
+
+      if (next->onMainThread) {
+        std::lock_guard<std::mutex> lock( mainMutex );
+        mainTasks.add( nt );
+      }
+      else {
+        push( self, nt );
+        numReady++;
+      }
+    }
+
+    if (numReady > 0)
+      wakeWorkers( numReady > 1 );
+  }
+
+  (*t.unfinished)--;
+}
+
+
+void JobPool::wakeWorkers( bool all )
+
+{
+  if (numWorkers == 0)
+    return;
+
+  // Taking the lock means that a worker that has just found nothing
+  // to do is either not yet checking for work, or already waiting
+
+  { std::lock_guard<std::mutex> lock( sleepMutex ); }
+
+  if (all)
+    wake.notify_all();
+  else
+    wake.notify_one();
+}
+
+
+// Run tasks until 'unfinished' reaches zero.  The main thread also
+// runs the jobs that are queued for it.
+
+void JobPool::waitFor( std::atomic<int> &unfinished )
+
+{
+  int self = threadIndex();
+  bool isMain = (std::this_thread::get_id() == mainThread);
+
+  while (unfinished > 0) {
+
+    if (isMain && runMainThreadJobs() > 0)
+      continue;
+
+    Task t;
+
+    if (findTask( self, t ))
+      runTask( self, t );
+    else
+      std::this_thread::yield(); // the rest are running on other threads
+  }
+}
+
+
+void JobPool::parallelFor( const char *name, int n, int chunk, const JobBody &body )
+
+{
+  if (chunk < 1)
+    chunk = 1;
+
+  if (numWorkers == 0 || n <= chunk) { // not worth waking anyone
+    if (n > 0) {
+      PROFILE_JOB_SCOPE( name );
+      body( 0, n );
+    }
+    return;
+  }
+
+  int self = threadIndex();
+  int numChunks = (n + chunk - 1) / chunk;
+
+  std::atomic<int> unfinished( numChunks );
+
+  // Push the chunks last first, so that this thread starts at the
+  // beginning and thieves take from the end
+
+  for (int i=numChunks-1; i>=0; i--) {
+    Task t = { name, &body, i*chunk, (i+1 < numChunks ? (i+1)*chunk : n), NULL, &unfinished };
+    push( self, t );
+  }
+
+  wakeWorkers( true );
+  waitFor( unfinished );
+}
+
+
+void JobPool::run( JobGraph &graph )
+
+{
+  int self = threadIndex();
+
+  std::atomic<int> unfinished( graph.size() );
+
+  for (int i=0; i<graph.size(); i++)
+    graph.jobs[i]->waitingFor = graph.jobs[i]->numDeps;
+
+  for (int i=0; i<graph.size(); i++) {
+
+    JobGraph::Job *job = graph.jobs[i];
+
+    if (job->numDeps > 0)
+      continue;
+
+    Task t = { job->name, NULL, 0, 0, job, &unfinished };
+
+    if (job->onMainThread) {
+      std::lock_guard<std::mutex> lock( mainMutex );
+      mainTasks.add( t );
+    }
+    else
+      push( self, t );
+  }
+
+  wakeWorkers( true );
+  waitFor( unfinished );
+}
+
+
+int JobPool::runMainThreadJobs()
+
+{
+  int count = 0;
+
+  for (;;) {
+
+    Task t;
+
+    {
+      std::lock_guard<std::mutex> lock( mainMutex );
+
+      if (mainTasks.size() == 0)
+        return count;
+
+      t = mainTasks[0];
+      mainTasks.remove( 0 );
+    }
+
+    runTask( 0, t );
+    count++;
+  }
+}
+
+
+void JobPool::work( int self )
+
+{
+  PROFILE_THREAD( "worker" );
+
+  currentPool = this;
+  currentIndex = self;
+
+  {
+    std::lock_guard<std::mutex> lock( sleepMutex );
+    numStarted++;
+  }
+  started.notify_one();
+
+  for (;;) {
+
+    Task t;
+
+    if (findTask( self, t )) {
+      runTask( self, t );
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock( sleepMutex );
+    wake.wait( lock, [this]{ return quit || numQueued > 0; } );
+
+    if (quit)
+      return;
+  }
+}
+
+
+// The pool is never deleted: its workers are left asleep when the
+// program exits, so that exit() can be called from any thread
+
+JobPool &jobPool()
+
+{
+  static JobPool *pool = new JobPool( worldConfig.threads );
+
+  return *pool;
+}
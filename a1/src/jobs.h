@@ -0,0 +1,164 @@
+// jobs.h
+//
+// The job system: one pool of worker threads, shared by everything in
+// the program that has work to split up, from the centipede updates
+// each tick to building the meshes at startup.  Get it with
+// jobPool().
+//
+// Each thread of the pool has a deque of tasks that are ready to run.
+// A thread pushes the tasks that it creates onto the back of its own
+// deque and takes its next task from the back, so it finishes what it
+// has just started while that is still in its cache.  A thread whose
+// deque is empty steals from the front of another thread's deque,
+// taking the oldest task there.  The thread that created the pool
+// (the "main thread") is thread 0 of the pool.  Threads outside the
+// pool, such as the simulation thread, share its deque.  Idle workers
+// sleep on a condition variable.
+//
+// There are two ways to give the pool work:
+//
+// parallelFor( name, n, chunk, body ) calls body( begin, end ) for
+// chunks of [0,n) of 'chunk' iterations, and returns when every chunk
+// is done.  Which thread runs which chunk varies from call to call:
+// the body must give the same result whichever thread runs it, and
+// chunks must not write to the same data.
+//
+// run( graph ) runs the jobs of a JobGraph, each one after the jobs
+// that it depends on, and returns when they are all done.
+//
+// A job that makes GL calls has to run on the thread that owns the GL
+// context, which is the main thread.  Such jobs are added to a graph
+// with addOnMainThread().  When they're ready they go on a queue of
+// their own rather than on a deque.  The main thread runs that queue
+// with runMainThreadJobs() while it waits for a loop or a graph, and
+// once a frame.
+//
+// A thread that is waiting for a loop or a graph runs other tasks in
+// the meantime, so a job can itself call parallelFor or run a graph.
+//
+// With PROFILE, each chunk and job is timed as a span named after its
+// loop or job, in the "job" category.  That shows which thread ran
+// what in a trace.
+
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "headers.h"
+#include "seq.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define JOB_DEQUE_SIZE 1024 // tasks per thread; must be a power of two
+
+
+typedef std::function<void( int begin, int end )> JobBody;
+typedef std::function<void()> JobFunc;
+
+
+// A set of jobs with dependencies between them.  A graph can be run
+// more than once, but not by two threads at the same time.
+
+class JobGraph {
+
+  friend class JobPool;
+
+  struct Job {
+    const char *name;
+    JobFunc     func;
+    bool        onMainThread;
+    seq<Job *>  successors;     // jobs that depend on this one
+    int         numDeps;
+    std::atomic<int> waitingFor; // dependencies not yet done in the current run
+  };
+
+  seq<Job *> jobs;
+
+  int addJob( const char *name, const JobFunc &func, bool onMainThread );
+
+ public:
+
+  ~JobGraph();
+
+  int add( const char *name, const JobFunc &func ) { return addJob( name, func, false ); }
+  int addOnMainThread( const char *name, const JobFunc &func ) { return addJob( name, func, true ); }
+
+  void depends( int job, int on ); // 'job' can't start until 'on' is done
+
+  int size() const { return jobs.size(); }
+};
+
+
+class JobPool {
+
+  // A chunk of a loop, or a job of a graph
+
+  struct Task {
+    const char *name;
+    const JobBody *body;
+    int begin, end;
+    JobGraph::Job *job;
+    std::atomic<int> *unfinished; // tasks of the loop or graph that aren't done
+  };
+
+  // One thread's tasks.  The owner works at the back; thieves take from
+  // the front.
+
+  struct TaskDeque {
+    std::mutex mutex;
+    Task tasks[ JOB_DEQUE_SIZE ];
+    unsigned int front, back;   // the tasks are in [front,back), modulo JOB_DEQUE_SIZE
+
+    TaskDeque() { front = back = 0; }
+  };
+
+  std::thread *workers;
+  int numWorkers;
+  TaskDeque *deques;            // one per thread: [0] is the main thread's
+
+  std::thread::id mainThread;
+
+  std::mutex mainMutex;
+  seq<Task> mainTasks;          // ready jobs that must run on the main thread
+
+  std::atomic<int> numQueued;   // tasks in all of the deques
+  std::mutex sleepMutex;
+  std::condition_variable wake; // there's a task to take (or the pool is shutting down)
+  bool quit;
+
+  int numStarted;               // workers that have started (and registered with the profiler)
+  std::condition_variable started;
+
+  int  threadIndex();
+  void push( int self, const Task &t );
+  bool findTask( int self, Task &t );
+  void runTask( int self, Task &t );
+  void wakeWorkers( bool all );
+  void waitFor( std::atomic<int> &unfinished );
+  void work( int self );
+
+ public:
+
+  JobPool( int numThreads );    // threads including the main thread; 0 for one per core
+  ~JobPool();
+
+  int numThreads() const { return numWorkers + 1; }
+
+  void parallelFor( const char *name, int n, int chunk, const JobBody &body );
+  void run( JobGraph &graph );
+
+  int runMainThreadJobs();      // call on the main thread only; returns the number of jobs run
+};
+
+
+// The program's pool, created with worldConfig.threads threads on the
+// first call, which should be on the main thread once the world config
+// has been read.
+
+JobPool &jobPool();
+
+#endif
@@ -0,0 +1,35 @@
+// latency.cpp
+
+
+#include "latency.h"
+
+#include <algorithm>
+
+
+// Print the count, mean, percentiles and maximum of the samples, in ms
+
+void LatencyStats::report( const char *name )
+
+{
+  int n = samples.size();
+
+  if (n == 0) {
+    cout << name << ": no samples" << endl;
+    return;
+  }
+
+  float *s = samples.array();
+  sort( s, s+n );
+
+  double sum = 0;
+  for (int i=0; i<n; i++)
+    sum += s[i];
+
+#define PERCENTILE(p) (1000 * s[ std::min( n-1, (int) ((p) * n) ) ])
+
+  printf( "%s: %d samples  mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+          name, n, 1000 * sum / n,
+          PERCENTILE(0.50), PERCENTILE(0.90), PERCENTILE(0.99), 1000 * s[n-1] );
+
+#undef PERCENTILE
+}
@@ -0,0 +1,26 @@
+// latency.h
+//
+// Collects input-to-photon latency samples (in seconds) and reports
+// their distribution.
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "headers.h"
+#include "seq.h"
+
+
+class LatencyStats {
+
+  seq<float> samples;
+
+ public:
+
+  void add( double seconds ) { samples.add( seconds ); }
+  int  count() { return samples.size(); }
+
+  void report( const char *name );
+};
+
+#endif
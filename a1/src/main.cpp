@@ -5,7 +5,18 @@
 #include "headers.h"
 #include "gpuProgram.h"
 #include "world.h"
+#include "renderer.h"
+#include "triplebuffer.h"
+#include "input.h"
+#include "latency.h"
+#include "profiler.h"
+#include "gputimer.h"
 #include "strokefont.h"
+#include "jobs.h"
+#include "pool.h"
+#include "arena.h"
+
+#include <thread>
 
 GLFWwindow *window;
 
@@ -13,16 +24,53 @@ GPUProgram *gpuProg; // pointer to GPU program object
 
 World *world; // the world, including centipede, mushrooms, etc.
 
+Renderer *renderer; // draws snapshots of the world
+
+// The simulation runs on its own thread and publishes a snapshot of
+// the world after each tick.  The main thread owns the window and the
+// GL context, and draws whichever snapshot is most recent.
+
+TripleBuffer<RenderSnapshot> snapshots;
+
+std::atomic<bool> simRunning(true);
+
+// These belong to the simulation thread and are changed only through
+// input events.
+
 bool pauseGame = false;
 float speedMultiplier = 1.0; // Press + or - to change the centipede speed through this variable
 
+unsigned int simTick = 0; // number of simulation ticks so far
+
+// Input travels from the GLFW callbacks to the simulation through
+// 'inputQueue'.  Applied events can be recorded, and a recording can
+// be replayed in place of live input.
+
+InputQueue inputQueue;
+InputRecorder recorder;
+InputReplay replay;
+bool replaying = false;
+
+double lastMoveTime = 0; // arrival time of the last INPUT_MOVE applied
+
+// Latency measurement (with -latency).  For each player move, the time
+// from the mouse event to the completion of the first swap that shows
+// it is recorded, separately for late-latched and simulated positions.
+
+bool measureLatency = false;
+double lastCursorTime = 0;   // arrival time of the latest mouse event
+double lastMeasuredTime = 0; // arrival time of the latest event measured
+LatencyStats lateLatchLatency;
+LatencyStats simulatedLatency;
+
 int screenWidth = 900;   // 1265*1;
 int screenHeight = 1200; // 800*1;
 
 // Shaders for the world objects
 //
-// These shaders take a 2D position as attribute 0 and an RGB colour
-// as attribute 1.
+// These shaders take a 2D position as attribute 0 and a palette index
+// as attribute 1 (see vertexformat.h).  The palette is a uniform array
+// of RGB colours.
 
 char *mainVertexShader =
 
@@ -30,15 +78,16 @@ char *mainVertexShader =
   #version 300 es
 
   layout (location = 0) in vec2 position;
-  layout (location = 1) in vec3 colour_in;
+  layout (location = 1) in uint colourIndex;
   out mediump vec3 colour;
   uniform mat4 MVP;
+  uniform vec3 palette[32]; // MAX_PALETTE_COLOURS
   
   void main()
   
   {
     gl_Position = MVP * vec4(position, 0, 1);
-    colour = colour_in;
+    colour = palette[colourIndex];
   }
 
 )XX";
@@ -59,6 +108,20 @@ char *mainFragmentShader =
 
 )XX";
 
+// Queue an input event for the simulation thread
+
+void pushInput(InputType type, vec2 pos = vec2(0, 0))
+{
+  InputEvent e;
+
+  e.type = type;
+  e.pos = pos;
+  e.time = inputClock();
+
+  if (!inputQueue.push(e))
+    cerr << "Input queue is full: event dropped" << endl;
+}
+
 // Handle a keypress
 
 void keyCallback(GLFWwindow *w, int key, int scancode, int action, int mods)
@@ -67,31 +130,38 @@ void keyCallback(GLFWwindow *w, int key, int scancode, int action, int mods)
   {
 
     if (key == GLFW_KEY_ESCAPE) // quit upon ESC
-      exit(0);
+      glfwSetWindowShouldClose(w, GLFW_TRUE);
 
     else if (key == 'P') // p = pause
-      pauseGame = !pauseGame;
+      pushInput(INPUT_PAUSE);
+
+    else if (key == 'S') // s = start again (only once the game is over)
+      pushInput(INPUT_RESTART);
 
-    else if (key == 'S')
-    { // s = start again
-      if (world->gameOver)
-      {
-        pauseGame = false;
-        speedMultiplier = 1;
-        world->initWorld(window);
-      }
-    }
     else if (key == '=') // + = pause
-      speedMultiplier *= 2;
+      pushInput(INPUT_FASTER);
 
     else if (key == '-') // - = slower
-      speedMultiplier /= 2;
+      pushInput(INPUT_SLOWER);
+
+    else if (key == 'F') // f = frame profiler overlay (toggle; needs a PROFILE build)
+      PROFILE_TOGGLE_OVERLAY();
+
+    else if (key == 'L') // l = late latching of the player (toggle)
+      renderer->lateLatch = !renderer->lateLatch;
 
     else if (key == 'H') // h = help
-      cout << "p - pause (toggle)" << endl;
+      cout << "p - pause (toggle)" << endl
+           << "s - start again (once the game is over)" << endl
+           << "+ - faster" << endl
+           << "- - slower" << endl
+           << "f - frame profiler overlay (toggle; needs a PROFILE build)" << endl
+           << "l - late latching of the player (toggle)" << endl
+           << "space - fire" << endl
+           << "ESC - quit" << endl;
 
     else if (key == ' ')
-      world->playerFire();
+      pushInput(INPUT_FIRE);
   }
 }
 
@@ -117,7 +187,218 @@ void windowSizeCallback(GLFWwindow *window, int width, int height)
 
 void mousePositionCallback(GLFWwindow *window, double xpos, double ypos)
 {
-  world->playerMove(vec2(xpos, ypos));
+  lastCursorTime = inputClock();
+
+  pushInput(INPUT_MOVE, Renderer::windowToWorld(window, xpos, ypos));
+}
+
+// Record the latency of the newest player move shown in the frame
+// that was just swapped.  Called on the main thread after the swap.
+
+void measureFrameLatency(RenderSnapshot &snap)
+{
+  glFinish(); // wait for the swap to complete
+
+  double now = inputClock();
+
+  if (renderer->lateLatch)
+  {
+    if (lastCursorTime > lastMeasuredTime)
+    {
+      lateLatchLatency.add(now - lastCursorTime);
+      lastMeasuredTime = lastCursorTime;
+    }
+  }
+  else if (snap.lastMoveTime > lastMeasuredTime)
+  {
+    simulatedLatency.add(now - snap.lastMoveTime);
+    lastMeasuredTime = snap.lastMoveTime;
+  }
+}
+
+// Apply one input event to the world.  Called on the simulation
+// thread at a tick boundary.
+
+void applyInput(InputEvent &e)
+{
+  recorder.record(simTick, e);
+
+  switch (e.type)
+  {
+  case INPUT_MOVE:
+    world->playerMove(e.pos);
+    lastMoveTime = e.time;
+    break;
+
+  case INPUT_FIRE:
+    world->playerFire();
+    break;
+
+  case INPUT_PAUSE:
+    pauseGame = !pauseGame;
+    break;
+
+  case INPUT_FASTER:
+    speedMultiplier *= 2;
+    break;
+
+  case INPUT_SLOWER:
+    speedMultiplier /= 2;
+    break;
+
+  case INPUT_RESTART:
+    if (world->gameOver)
+    {
+      pauseGame = false;
+      speedMultiplier = 1;
+      world->initWorld();
+    }
+    break;
+  }
+}
+
+// Advance the simulation by one tick.  Input is drained first, so
+// everything that arrived during the previous tick takes effect at
+// this tick boundary.  While replaying, live input is discarded.
+
+void simulationStep()
+{
+  PROFILE_SCOPE("tick");
+
+  {
+    PROFILE_SCOPE("input");
+
+    InputEvent e;
+
+    if (replaying)
+    {
+      while (replay.nextEventAt(simTick, e))
+        applyInput(e);
+
+      while (inputQueue.pop(e))
+        ;
+
+      if (replay.finished(simTick))
+        replaying = false; // hand control back to the player
+    }
+    else
+      while (inputQueue.pop(e))
+        applyInput(e);
+  }
+
+  if (!pauseGame)
+    world->updateState(1.0 / SIM_TICKS_PER_SECOND);
+
+  simTick++;
+}
+
+// The simulation thread.  Advance the world in fixed ticks of
+// 1/SIM_TICKS_PER_SECOND seconds and publish a snapshot after each.
+
+void simulate()
+{
+  const chrono::microseconds tickLength(1000000 / SIM_TICKS_PER_SECOND);
+
+  chrono::steady_clock::time_point nextTick = chrono::steady_clock::now();
+
+  PROFILE_THREAD("simulation");
+
+  while (simRunning)
+  {
+    simulationStep();
+
+    {
+      PROFILE_SCOPE("snapshot");
+
+      world->publishSnapshot(snapshots.writeBuffer());
+      snapshots.writeBuffer().lastMoveTime = lastMoveTime;
+      snapshots.publish();
+    }
+
+    // Wait for the next tick.  If we've fallen far behind (e.g. the
+    // process was stopped), don't try to catch up all at once.
+
+    nextTick += tickLength;
+
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (now - nextTick > chrono::milliseconds(250))
+      nextTick = now;
+
+    this_thread::sleep_until(nextTick);
+  }
+}
+
+// Run the simulation without a window, as fast as possible, until
+// the replay ends (or for 'maxTicks' ticks if there is no replay).
+// The final state is printed so that runs can be compared, along with
+// the number of times the entity pools went to the heap once the game
+// had started (see pool.h), which should be none.
+//
+// With 'checkAllocs' (PROFILE builds only), a snapshot is published
+// after each tick, as the simulation thread does, and the run fails
+// on the first tick that allocates from the heap, other than a tick
+// in which a level starts.
+
+int runHeadless(unsigned int maxTicks, bool checkAllocs)
+{
+  world = new World();
+
+  long poolAllocationsAtStart = poolHeapAllocations;
+
+  PROFILE_THREAD("simulation");
+
+  while (replaying ? !replay.finished(simTick) : simTick < maxTicks)
+  {
+#ifdef PROFILE
+    AllocCount allocsBefore = totalAllocCount();
+    unsigned int levelsBefore = world->levelsStarted;
+#endif
+
+    simulationStep();
+
+    if (checkAllocs)
+    {
+      world->publishSnapshot(snapshots.writeBuffer());
+      snapshots.publish();
+    }
+
+#ifdef PROFILE
+    AllocCount allocsAfter = totalAllocCount();
+
+    if (checkAllocs && allocsAfter.allocs != allocsBefore.allocs && world->levelsStarted == levelsBefore)
+    {
+      cerr << "tick " << simTick - 1 << " made " << allocsAfter.allocs - allocsBefore.allocs
+           << " heap allocations (" << allocsAfter.bytes - allocsBefore.bytes << " bytes)" << endl;
+      return 1;
+    }
+#endif
+
+    PROFILE_FRAME(); // each tick is a frame when there's no window
+  }
+
+  RenderSnapshot &snap = snapshots.writeBuffer();
+  world->publishSnapshot(snap);
+
+  cout << "tick " << simTick
+       << " score " << snap.score
+       << " level " << snap.level + 1
+       << " lives " << snap.livesRemaining
+       << (snap.gameOver ? " game over" : "") << endl;
+
+  cout << "pool heap allocations " << poolHeapAllocations - poolAllocationsAtStart << endl;
+
+  PROFILE_REPORT();
+  PROFILE_STOP_TRACE();
+
+  recorder.close(simTick);
+  return 0;
+}
+
+void usage(char *prog)
+{
+  cerr << "Usage: " << prog << " [-record file] [-replay file] [-headless [-ticks n] [-noalloc]] [-latency] [-trace file] [-gputime]"
+       << " [-config file|help] [-set name=value]" << endl;
+  exit(1);
 }
 
 // Main program
@@ -125,6 +406,93 @@ void mousePositionCallback(GLFWwindow *window, double xpos, double ypos)
 int main(int argc, char **argv)
 
 {
+  bool headless = false;
+  bool checkAllocs = false;
+#ifdef PROFILE
+  bool gpuTiming = false;
+#endif
+  unsigned int maxTicks = 60 * SIM_TICKS_PER_SECOND;
+
+  for (int i = 1; i < argc; i++)
+    if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+    {
+      if (!recorder.open(argv[++i]))
+        return 1;
+    }
+    else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+    {
+      if (!replay.open(argv[++i]))
+        return 1;
+      replaying = true;
+    }
+    else if (strcmp(argv[i], "-headless") == 0)
+      headless = true;
+    else if (strcmp(argv[i], "-ticks") == 0 && i + 1 < argc)
+      maxTicks = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc)
+    {
+      if (strcmp(argv[++i], "help") == 0)
+      {
+        worldConfig.printHelp(cout);
+        return 0;
+      }
+      if (!worldConfig.load(argv[i]))
+        return 1;
+    }
+    else if (strcmp(argv[i], "-set") == 0 && i + 1 < argc)
+    {
+      if (!worldConfig.set(argv[++i]))
+        return 1;
+    }
+    else if (strcmp(argv[i], "-latency") == 0)
+      measureLatency = true;
+    else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+    {
+#ifdef PROFILE
+      if (!profilerStartTrace(argv[++i]))
+        return 1;
+#else
+      cerr << "-trace needs a PROFILE build (make PROFILE=1)" << endl;
+      return 1;
+#endif
+    }
+    else if (strcmp(argv[i], "-noalloc") == 0)
+    {
+#ifdef PROFILE
+      checkAllocs = true;
+#else
+      cerr << "-noalloc needs a PROFILE build (make PROFILE=1)" << endl;
+      return 1;
+#endif
+    }
+    else if (strcmp(argv[i], "-gputime") == 0)
+    {
+#ifdef PROFILE
+      gpuTiming = true;
+#else
+      cerr << "-gputime needs a PROFILE build (make PROFILE=1)" << endl;
+      return 1;
+#endif
+    }
+    else
+      usage(argv[0]);
+
+  if (!worldConfig.validate())
+    return 1;
+
+  // Start the job pool on this thread, which makes this the thread
+  // that runs the pool's GL jobs
+
+  jobPool();
+
+  // Make room in the snapshots for everything the config allows
+
+  for (int i = 0; i < 3; i++)
+    snapshots.buffer(i).reserve();
+
+  if (headless)
+    return runHeadless(maxTicks, checkAllocs);
+
   // Set up GLFW
 
   if (!glfwInit())
@@ -187,62 +555,97 @@ int main(int argc, char **argv)
 
   setupStrokeStrings();
 
+  // Set up the renderer, which builds all of the geometry
+
+  renderer = new Renderer(window);
+
+#ifdef PROFILE
+  if (gpuTiming)
+    gpuTimer.init();
+#endif
+
+  if (replaying)
+    renderer->lateLatch = false; // the player is driven by the replay, not the mouse
+
   // Set up world
 
-  world = new World(window);
+  world = new World();
+
+  world->publishSnapshot(snapshots.writeBuffer());
+  snapshots.publish();
 
   // Turn off cursor, as the player icon will be used instead.  Also,
   // position the cursor on the player.
 
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 
-  float mouseX = (INIT_PLAYER_POS.x - world->l) / (world->r - world->l) * screenWidth;
-  float mouseY = (INIT_PLAYER_POS.y - world->t) / (world->b - world->t) * screenHeight;
+  float mouseX = (INIT_PLAYER_POS.x - renderer->l) / (renderer->r - renderer->l) * screenWidth;
+  float mouseY = (INIT_PLAYER_POS.y - renderer->t) / (renderer->b - renderer->t) * screenHeight;
 
   glfwSetCursorPos(window, mouseX, mouseY);
 
-  // Run
+  // Run the simulation on its own thread
 
-  chrono::system_clock::time_point prevTime = chrono::system_clock::now();
+  thread simThread(simulate);
+
+  PROFILE_THREAD("render");
 
   while (!glfwWindowShouldClose(window))
   {
 
-    // Find elapsed time since last render
+    // Take back the last frame's transient memory
+
+    frameArena.reset();
+
+    // Display the latest snapshot of the world
 
-    float elapsedTime = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - prevTime).count() / 1000.0;
+    snapshots.fetch();
 
-    prevTime = chrono::system_clock::now();
+    RenderSnapshot &snap = snapshots.readBuffer();
+
+    {
+      PROFILE_GL_SCOPE("draw");
+      renderer->draw(snap);
+    }
 
-    // Update the world state
+    PROFILE_DRAW_OVERLAY();
 
-    if (!pauseGame)
-      world->updateState(elapsedTime);
+    {
+      PROFILE_GL_SCOPE("swap");
+      glfwSwapBuffers(window);
+    }
 
-    // Display the world
+    if (measureLatency)
+      measureFrameLatency(snap);
 
-    world->draw();
+    // Run any GL work queued by jobs
 
-    glfwSwapBuffers(window);
+    jobPool().runMainThreadJobs();
 
     // Check for new events
 
-    glfwPollEvents();
+    {
+      PROFILE_SCOPE("poll");
+      glfwPollEvents();
+    }
+
+    PROFILE_FRAME();
   }
 
-  glfwDestroyWindow(window);
-  glfwTerminate();
-  return 0;
-}
+  simRunning = false;
+  simThread.join();
 
-// A bug in some GL* library in Ubuntu 14.04 requires that libpthread
-// be forced to load.  The code below accomplishes this (from MikeMx7f
-// http://stackoverflow.com/questions/31579243/segmentation-fault-before-main-when-using-glut-and-stdstring).
-//
-// You'll also need to modify the Makefile to uncomment the pthread parts
+  recorder.close(simTick);
 
-// #include <pthread.h>
+  PROFILE_STOP_TRACE();
 
-// void* simpleFunc(void*) { return NULL; }
+  if (measureLatency)
+  {
+    lateLatchLatency.report("late-latched input-to-swap latency");
+    simulatedLatency.report("simulated input-to-swap latency");
+  }
 
-// void forcePThreadLink() { pthread_t t1; pthread_create(&t1, NULL, &simpleFunc, NULL); }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
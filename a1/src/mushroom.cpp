@@ -3,6 +3,7 @@
 #include "mushroom.h"
 #include "main.h"
 #include "worldDefs.h"
+#include "vertexformat.h"
 
 extern GLFWwindow *window;
 #define LINE_HALFWIDTH_IN_PIXELS 2.0
@@ -71,28 +72,6 @@ static void addThickArcStrip(seq<vec2> &positions, seq<vec3> &colours,
     colours.add(colour);
 }
 
-static void uploadInterleavedToBoundVBO(GLuint VBO, const seq<vec2> &positions, const seq<vec3> &colours)
-{
-  int numFloats = positions.size() * (2 + 3);
-  float *buffer = new float[numFloats];
-
-  float *p = buffer;
-  for (int i = 0; i < positions.size(); i++)
-  {
-    *p++ = positions[i].x;
-    *p++ = positions[i].y;
-    *p++ = colours[i].x;
-    *p++ = colours[i].y;
-    *p++ = colours[i].z;
-  }
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, numFloats * sizeof(float), buffer, GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-  delete[] buffer;
-}
-
 void Mushroom::generateVAOs()
 {
   // [YOUR CODE HERE]
@@ -121,7 +100,7 @@ void Mushroom::generateVAOs()
   float lw = LINE_HALFWIDTH_IN_PIXELS / (float)height * 2.0f;
 
   // Properly size the mushrrom by tying it to the grid spacing.
-  float R = 0.25f * COL_SPACING; // reduced radius, otherwise mushrooms look too large.
+  float R = 0.25f * worldConfig.colSpacing; // reduced radius, otherwise mushrooms look too large.
 
   // Proportions (single model)
   float capR = 0.95f * R;
@@ -158,11 +137,7 @@ void Mushroom::generateVAOs()
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    setupPackedVertexAttribs(); // position and palette index
 
     glBindVertexArray(0);
 
@@ -252,7 +227,7 @@ void Mushroom::generateVAOs()
     }
 
     // Upload interleaved data to the VBO
-    uploadInterleavedToBoundVBO(VBO, positions, colours);
+    uploadInterleaved(VBO, positions, colours);
   }
 
   // Build the MASK VAO and DrawBuffers (maskDb)
@@ -265,11 +240,7 @@ void Mushroom::generateVAOs()
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    setupPackedVertexAttribs(); // position and palette index
 
     glBindVertexArray(0);
 
@@ -302,11 +273,11 @@ void Mushroom::generateVAOs()
     maskDb->first.add(offset);
     maskDb->count.add(positions.size() - offset);
 
-    uploadInterleavedToBoundVBO(VBO, positions, colours);
+    uploadInterleaved(VBO, positions, colours);
   }
 }
 
-void Mushroom::draw(mat4 &worldToViewTransform)
+void Mushroom::draw(vec2 pos, int damage, mat4 &worldToViewTransform)
 {
   // Provide base translation for this mushroom instance
   mat4 T = translate(pos.x, pos.y, 0.0f);
@@ -1,11 +1,18 @@
 // mushroom.h
 
+#ifndef MUSHROOM_H
+#define MUSHROOM_H
+
 #include "headers.h"
 #include "drawbuffer.h"
+#include "slotmap.h"
 
 #define MUSH_BODY_COLOUR vec3(1.000, 0.129, 0.741)
 #define MUSH_OUTLINE_COLOUR vec3(0.031, 0.851, 0.776)
 
+class Mushroom;
+typedef Handle<Mushroom> MushroomHandle;
+
 class Mushroom
 {
 
@@ -25,16 +32,21 @@ public:
   vec2 pos;
   int damage;
 
+  MushroomHandle nextInCell; // next mushroom in the same grid cell (see mushroomgrid.h)
+  unsigned int serial;       // order in which mushrooms were added to the grid
+
+  Mushroom() {}
+
   Mushroom(vec2 _pos)
   {
 
     pos = _pos;
     damage = 0;
-
-    if (db == NULL)
-      generateVAOs();
+    serial = 0;
   }
 
-  void generateVAOs();
-  void draw(mat4 &worldToViewTransform);
+  static void generateVAOs();
+  static void draw(vec2 pos, int damage, mat4 &worldToViewTransform);
 };
+
+#endif
@@ -0,0 +1,532 @@
+// mushroomgrid.h
+//
+// An index of the mushrooms by grid cell, so that
+// World::findClosestMushroomAhead can find the closest mushroom along
+// a row or column without testing every mushroom.  The grid holds
+// handles into the SlotMap of mushrooms that it was constructed with.
+//
+// Each row and each column of the grid has a bitboard of the occupied
+// cells, so finding the next occupied cell ahead is a bit scan.  Each
+// cell has a list (through Mushroom::nextInCell) of the mushrooms in
+// it, oldest first.  Mushrooms that aren't exactly on a grid point
+// (or are outside the grid, e.g. in the player area) are kept in a
+// separate list and tested one by one.  Results are the same as those
+// of the linear scan in World, including which of two equally close
+// mushrooms is returned (the one added first).
+//
+// The grid is a template on its dimensions:
+//
+//   StandardGrid   the grid of the default world config, known at
+//                  compile time: the bitboards and cell lists are
+//                  fixed-size arrays and every loop bound is a constant
+//
+//   RuntimeGrid    the grid of the current world config, allocated
+//                  when the grid is cleared
+//
+// World uses the StandardGrid whenever the world config has the
+// default grid, and the RuntimeGrid otherwise.
+
+
+#ifndef MUSHROOMGRID_H
+#define MUSHROOMGRID_H
+
+#include "headers.h"
+#include "worldDefs.h"
+#include "mushroom.h"
+#include "seq.h"
+#include "slotmap.h"
+
+#include <stdint.h>
+#include <algorithm>
+
+#ifdef _WIN32
+  #include <intrin.h>
+#endif
+
+
+// Grid dimensions fixed at compile time
+
+struct StandardGrid {
+
+  static const bool fixed = true;
+
+  static constexpr int    numRows()    { return DEFAULT_NUM_ROWS; }
+  static constexpr double rowSpacing() { return DEFAULT_ROW_SPACING; }
+  static constexpr double colSpacing() { return DEFAULT_COL_SPACING; }
+  static constexpr int    numCols()    { return (int) ((WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE) / DEFAULT_COL_SPACING - 1); }
+
+  // Is the world config using this grid?
+
+  static bool matchesConfig() {
+    return worldConfig.numRows == numRows() &&
+           worldConfig.rowSpacing == rowSpacing() &&
+           worldConfig.colSpacing == colSpacing();
+  }
+};
+
+
+// Grid dimensions from the world config
+
+struct RuntimeGrid {
+
+  static const bool fixed = false;
+
+  static int    numRows()    { return worldConfig.numRows; }
+  static double rowSpacing() { return worldConfig.rowSpacing; }
+  static double colSpacing() { return worldConfig.colSpacing; }
+  static int    numCols()    { return worldConfig.numCols(); }
+};
+
+
+// Index of the lowest and highest set bits of a non-zero word
+
+inline int lowestBit( uint64_t x )
+
+{
+#ifdef _WIN32
+  unsigned long i;
+  _BitScanForward64( &i, x );
+  return i;
+#else
+  return __builtin_ctzll( x );
+#endif
+}
+
+
+inline int highestBit( uint64_t x )
+
+{
+#ifdef _WIN32
+  unsigned long i;
+  _BitScanReverse64( &i, x );
+  return i;
+#else
+  return 63 - __builtin_clzll( x );
+#endif
+}
+
+
+// Storage for the bitboards and cells: fixed-size arrays for a grid
+// known at compile time, and heap arrays otherwise.  'rowBits' has
+// one bit per column for each row, and 'colBits' one bit per row for
+// each column.  Each cell has the head of its list of mushrooms in
+// 'cells', and the tail, so that adding to the list doesn't walk it,
+// in 'tails'.
+
+template<class Grid, bool fixed = Grid::fixed> class MushroomGridStorage;
+
+
+template<class Grid> class MushroomGridStorage<Grid, true> {
+
+ protected:
+
+  static constexpr int rows = Grid::numRows();
+  static constexpr int cols = Grid::numCols();
+  static constexpr int rowWords = (cols + 63) / 64;
+  static constexpr int colWords = (rows + 63) / 64;
+
+  uint64_t rowBits[rows * rowWords];
+  uint64_t colBits[cols * colWords];
+  MushroomHandle cells[rows * cols];
+  MushroomHandle tails[rows * cols];
+
+  void allocate() {}
+};
+
+
+template<class Grid> class MushroomGridStorage<Grid, false> {
+
+ protected:
+
+  int rows, cols, rowWords, colWords;
+
+  uint64_t *rowBits;
+  uint64_t *colBits;
+  MushroomHandle *cells;
+  MushroomHandle *tails;
+
+  MushroomGridStorage() {
+    rows = cols = 0;
+    rowBits = colBits = NULL;
+    cells = tails = NULL;
+  }
+
+  ~MushroomGridStorage() {
+    delete [] rowBits;
+    delete [] colBits;
+    delete [] cells;
+    delete [] tails;
+  }
+
+  // (Re)allocate for the current dimensions
+
+  void allocate() {
+
+    if (rows == Grid::numRows() && cols == Grid::numCols())
+      return;
+
+    rows = Grid::numRows();
+    cols = Grid::numCols();
+    rowWords = (cols + 63) / 64;
+    colWords = (rows + 63) / 64;
+
+    delete [] rowBits;
+    delete [] colBits;
+    delete [] cells;
+    delete [] tails;
+
+    rowBits = new uint64_t[ rows * rowWords ];
+    colBits = new uint64_t[ cols * colWords ];
+    cells = new MushroomHandle[ rows * cols ];
+    tails = new MushroomHandle[ rows * cols ];
+  }
+};
+
+
+template<class Grid> class MushroomGrid : MushroomGridStorage<Grid> {
+
+  typedef MushroomGridStorage<Grid> S;
+
+  SlotMap<Mushroom> &mushrooms;
+
+  // Mushrooms that aren't on a grid point, with copies of their
+  // positions (mushrooms don't move) so that testing them doesn't
+  // have to look each one up
+
+  struct OffGridMushroom {
+    MushroomHandle h;
+    vec2 pos;
+    unsigned int serial;
+  };
+
+  seq<OffGridMushroom> offGrid;
+  unsigned int nextSerial;      // to order the mushrooms by when they were added
+
+  bool cellOf( vec2 pos, int &r, int &c );
+  vec2 gridPoint( int r, int c );
+
+  void setBits( int r, int c, bool occupied );
+
+  int nextInRow( int r, int c, int step );
+  int nextInCol( int c, int r, int step );
+
+  static bool ahead( vec2 mushPos, vec2 pos, vec2 dir, float maxPerpDist, float &dist );
+
+ public:
+
+  MushroomGrid( SlotMap<Mushroom> &_mushrooms ) : mushrooms( _mushrooms ) { clear(); }
+
+  void clear();
+  void reserve( int n ) { offGrid.reserve( n ); } // make room for 'n' mushrooms off the grid
+  void add( MushroomHandle h );
+  void remove( MushroomHandle h ); // (call before removing it from the SlotMap)
+
+  // Whether there's a mushroom at the grid point of row 'r' and column 'c'
+
+  bool occupied( int r, int c ) { return !S::cells[ r * S::cols + c ].isNull(); }
+
+  // Find the closest mushroom ahead of 'pos' in direction 'dir' (as in
+  // World::findClosestMushroomAhead).  Returns false if the grid can't
+  // answer the query, which is when 'dir' isn't along a row or column
+  // or 'maxPerpDist' is more than half the grid spacing.
+
+  bool findClosestAhead( vec2 pos, vec2 dir, float maxPerpDist, MushroomHandle &closest );
+};
+
+
+template<class Grid>
+void MushroomGrid<Grid>::clear()
+
+{
+  S::allocate();
+
+  for (int i=0; i<S::rows * S::rowWords; i++)
+    S::rowBits[i] = 0;
+
+  for (int i=0; i<S::cols * S::colWords; i++)
+    S::colBits[i] = 0;
+
+  for (int i=0; i<S::rows * S::cols; i++) {
+    S::cells[i] = MushroomHandle();
+    S::tails[i] = MushroomHandle();
+  }
+
+  offGrid.clear();
+  nextSerial = 0;
+}
+
+
+// The world position of a grid point (the same expression as in
+// World::initWorld, so that the floats match exactly)
+
+template<class Grid>
+vec2 MushroomGrid<Grid>::gridPoint( int r, int c )
+
+{
+  return vec2( WORLD_LEFT_EDGE + (c + 1) * Grid::colSpacing(), WORLD_TOP_ROW - r * Grid::rowSpacing() );
+}
+
+
+// The cell nearest to 'pos'.  Returns false if that's outside the grid.
+
+template<class Grid>
+bool MushroomGrid<Grid>::cellOf( vec2 pos, int &r, int &c )
+
+{
+  c = rint( (pos.x - WORLD_LEFT_EDGE) / Grid::colSpacing() - 1 );
+  r = rint( (WORLD_TOP_ROW - pos.y) / Grid::rowSpacing() );
+
+  return r >= 0 && r < S::rows && c >= 0 && c < S::cols;
+}
+
+
+template<class Grid>
+void MushroomGrid<Grid>::setBits( int r, int c, bool occupied )
+
+{
+  uint64_t &rowWord = S::rowBits[ r * S::rowWords + c / 64 ];
+  uint64_t &colWord = S::colBits[ c * S::colWords + r / 64 ];
+
+  if (occupied) {
+    rowWord |= (uint64_t) 1 << (c % 64);
+    colWord |= (uint64_t) 1 << (r % 64);
+  }
+  else {
+    rowWord &= ~((uint64_t) 1 << (c % 64));
+    colWord &= ~((uint64_t) 1 << (r % 64));
+  }
+}
+
+
+template<class Grid>
+void MushroomGrid<Grid>::add( MushroomHandle h )
+
+{
+  Mushroom *m = mushrooms.get( h );
+
+  m->serial = nextSerial++;
+  m->nextInCell = MushroomHandle();
+
+  int r, c;
+
+  if (!cellOf( m->pos, r, c ) || !(m->pos == gridPoint( r, c ))) {
+    OffGridMushroom o;
+    o.h = h;
+    o.pos = m->pos;
+    o.serial = m->serial;
+    offGrid.add( o );
+    return;
+  }
+
+  // Append to the cell's list, so that it stays oldest first
+
+  int cell = r * S::cols + c;
+
+  if (S::tails[cell].isNull())
+    S::cells[cell] = h;
+  else
+    mushrooms.get( S::tails[cell] )->nextInCell = h;
+
+  S::tails[cell] = h;
+
+  setBits( r, c, true );
+}
+
+
+template<class Grid>
+void MushroomGrid<Grid>::remove( MushroomHandle h )
+
+{
+  Mushroom *m = mushrooms.get( h );
+
+  int r, c;
+
+  if (!cellOf( m->pos, r, c ) || !(m->pos == gridPoint( r, c ))) {
+    for (int i=0; i<offGrid.size(); i++)
+      if (offGrid[i].h == h) {
+        offGrid[i] = offGrid[ offGrid.size()-1 ]; // (the order doesn't matter)
+        offGrid.remove();
+        break;
+      }
+    return;
+  }
+
+  int cell = r * S::cols + c;
+
+  MushroomHandle prev;          // (null while at the head of the list)
+  MushroomHandle *p = &S::cells[cell];
+  while (!p->isNull() && *p != h) {
+    prev = *p;
+    p = &mushrooms.get( *p )->nextInCell;
+  }
+
+  if (!p->isNull()) {
+    *p = m->nextInCell;
+    if (S::tails[cell] == h)
+      S::tails[cell] = prev;
+  }
+
+  if (S::cells[cell].isNull())
+    setBits( r, c, false );
+}
+
+
+// The next occupied column in row 'r', starting at column 'c' and
+// moving by 'step' (+1 or -1).  Returns -1 if there is none.
+
+template<class Grid>
+int MushroomGrid<Grid>::nextInRow( int r, int c, int step )
+
+{
+  uint64_t *bits = &S::rowBits[ r * S::rowWords ];
+
+  while (c >= 0 && c < S::cols) {
+
+    uint64_t word = bits[ c / 64 ];
+    int bit = c % 64;
+
+    if (step > 0) {
+      word &= ~(uint64_t) 0 << bit;                     // bits at or above 'bit'
+      if (word)
+        return (c / 64) * 64 + lowestBit( word );
+      c = (c / 64 + 1) * 64;
+    }
+    else {
+      word &= (bit == 63 ? ~(uint64_t) 0 : ((uint64_t) 1 << (bit + 1)) - 1); // bits at or below 'bit'
+      if (word)
+        return (c / 64) * 64 + highestBit( word );
+      c = (c / 64) * 64 - 1;
+    }
+  }
+
+  return -1;
+}
+
+
+// The next occupied row in column 'c', as above
+
+template<class Grid>
+int MushroomGrid<Grid>::nextInCol( int c, int r, int step )
+
+{
+  uint64_t *bits = &S::colBits[ c * S::colWords ];
+
+  while (r >= 0 && r < S::rows) {
+
+    uint64_t word = bits[ r / 64 ];
+    int bit = r % 64;
+
+    if (step > 0) {
+      word &= ~(uint64_t) 0 << bit;
+      if (word)
+        return (r / 64) * 64 + lowestBit( word );
+      r = (r / 64 + 1) * 64;
+    }
+    else {
+      word &= (bit == 63 ? ~(uint64_t) 0 : ((uint64_t) 1 << (bit + 1)) - 1);
+      if (word)
+        return (r / 64) * 64 + highestBit( word );
+      r = (r / 64) * 64 - 1;
+    }
+  }
+
+  return -1;
+}
+
+
+// The test of World::findClosestMushroomAhead for one mushroom
+
+template<class Grid>
+bool MushroomGrid<Grid>::ahead( vec2 mushPos, vec2 pos, vec2 dir, float maxPerpDist, float &dist )
+
+{
+  vec2 v = mushPos - pos;
+
+  float distAlongLine = v.x * dir.x + v.y * dir.y;
+  float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x);
+
+  dist = distAlongLine;
+  return distAlongLine > 0 && distPerpToLine < maxPerpDist;
+}
+
+
+template<class Grid>
+bool MushroomGrid<Grid>::findClosestAhead( vec2 pos, vec2 dir, float maxPerpDist, MushroomHandle &closest )
+
+{
+  bool alongRow = (dir.y == 0 && fabs( dir.x ) == 1);
+  bool alongCol = (dir.x == 0 && fabs( dir.y ) == 1);
+
+  if (!(alongRow && maxPerpDist < Grid::rowSpacing() / 2) &&
+      !(alongCol && maxPerpDist < Grid::colSpacing() / 2))
+    return false;
+
+  float minDist = MAXFLOAT;
+  unsigned int minSerial = 0;
+  closest = MushroomHandle();
+
+  // Only one row (or column) of the grid can be close enough to the
+  // line.  Scan it for the first occupied cell ahead of 'pos'.  Cells
+  // behind 'pos' fail the test in ahead(), so starting a cell early is
+  // harmless.
+
+  int r, c;
+  cellOf( pos, r, c );
+
+  if (alongRow && r >= 0 && r < S::rows) {
+
+    int step = (dir.x > 0 ? +1 : -1);
+    int start = std::min( std::max( c - step, 0 ), S::cols - 1 );
+
+    for (int col = nextInRow( r, start, step ); col >= 0; col = nextInRow( r, col + step, step )) {
+      float dist;
+      MushroomHandle h = S::cells[ r * S::cols + col ];
+      Mushroom *m = mushrooms.get( h );
+      if (ahead( m->pos, pos, dir, maxPerpDist, dist )) {
+        closest = h;
+        minDist = dist;
+        minSerial = m->serial;
+        break;
+      }
+      if (dist > 0)
+        break; // ahead, but too far from the line, as is the rest of the row
+    }
+  }
+
+  if (alongCol && c >= 0 && c < S::cols) {
+
+    int step = (dir.y > 0 ? -1 : +1); // rows are numbered from the top
+    int start = std::min( std::max( r - step, 0 ), S::rows - 1 );
+
+    for (int row = nextInCol( c, start, step ); row >= 0; row = nextInCol( c, row + step, step )) {
+      float dist;
+      MushroomHandle h = S::cells[ row * S::cols + c ];
+      Mushroom *m = mushrooms.get( h );
+      if (ahead( m->pos, pos, dir, maxPerpDist, dist )) {
+        closest = h;
+        minDist = dist;
+        minSerial = m->serial;
+        break;
+      }
+      if (dist > 0)
+        break;
+    }
+  }
+
+  // Mushrooms off the grid
+
+  for (int i=0; i<offGrid.size(); i++) {
+    float dist;
+    OffGridMushroom &o = offGrid[i];
+    if (ahead( o.pos, pos, dir, maxPerpDist, dist ))
+      if (dist < minDist || (dist == minDist && o.serial < minSerial)) {
+        closest = o.h;
+        minDist = dist;
+        minSerial = o.serial;
+      }
+  }
+
+  return true;
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "player.h"
 #include "main.h"
+#include "vertexformat.h"
 #include "worldDefs.h"
 
 
@@ -12,23 +13,28 @@
 void Player::moveTo( vec2 _pos ) 
 
 {
-  // Keep the player in at the bottom of the screen
-    
-  if (_pos.x < WORLD_LEFT_EDGE + COL_SPACING)
-    _pos.x = WORLD_LEFT_EDGE + COL_SPACING;
+  pos = clampToPlayerArea( _pos );
+}
 
-  if (_pos.x > WORLD_RIGHT_EDGE - COL_SPACING)
-    _pos.x = WORLD_RIGHT_EDGE - COL_SPACING;
 
-  if (_pos.y > WORLD_BOTTOM_ROW - ROW_SPACING)
-    _pos.y = WORLD_BOTTOM_ROW - ROW_SPACING;
+// Keep the player in at the bottom of the screen
 
-  if (_pos.y < -1 + ROW_SPACING) // -1 is the bottom edge of the screen
-    _pos.y = -1 + ROW_SPACING;
+vec2 Player::clampToPlayerArea( vec2 _pos )
 
-  // Update position
-    
-  pos = _pos;
+{
+  if (_pos.x < WORLD_LEFT_EDGE + worldConfig.colSpacing)
+    _pos.x = WORLD_LEFT_EDGE + worldConfig.colSpacing;
+
+  if (_pos.x > WORLD_RIGHT_EDGE - worldConfig.colSpacing)
+    _pos.x = WORLD_RIGHT_EDGE - worldConfig.colSpacing;
+
+  if (_pos.y > WORLD_BOTTOM_ROW - worldConfig.rowSpacing)
+    _pos.y = WORLD_BOTTOM_ROW - worldConfig.rowSpacing;
+
+  if (_pos.y < -1 + worldConfig.rowSpacing) // -1 is the bottom edge of the screen
+    _pos.y = -1 + worldConfig.rowSpacing;
+
+  return _pos;
 }
 
 
@@ -37,7 +43,7 @@ void Player::moveTo( vec2 _pos )
 #define PLAYER_GEOM_COUNT 12
 
 #define PLAYER_GEOM_CENTRE vec2(3.5,3.5)
-#define PLAYER_GEOM_SCALE  (0.6 * ROW_SPACING / 9.0)
+#define PLAYER_GEOM_SCALE  (0.6 * worldConfig.rowSpacing / 9.0)
 
 #define PLAYER_EYE_X_RADIUS  1.5
 #define PLAYER_EYE_Y_RADIUS  2.0
@@ -82,11 +88,7 @@ void Player::generateVAOs()
 
   // Define the attributes
 
-  glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ); // two floats for a position
-  glEnableVertexAttribArray( 0 );
-
-  glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*) (2*sizeof(float)) ); // three floats for a colour
-  glEnableVertexAttribArray( 1 );
+  setupPackedVertexAttribs(); // position and palette index
 
   // Stop setting up this VAO.
 
@@ -152,27 +154,12 @@ void Player::generateVAOs()
 
   // ---------------- Copy positions and colours to the VBO ----------------
 
-  int numFloats = positions.size() * (2+3);
-
-  float *buffer = new float[ numFloats ];
-
-  float *p = buffer;
-  for (int i=0; i<positions.size(); i++) {
-    *p++ = positions[i].x;
-    *p++ = positions[i].y;
-    *p++ = colours[i].x;
-    *p++ = colours[i].y;
-    *p++ = colours[i].z;
-  }
-
-  glBufferData( GL_ARRAY_BUFFER, numFloats*sizeof(float), buffer, GL_STATIC_DRAW );
-      
-  glBindBuffer( GL_ARRAY_BUFFER, 0 );
+  uploadInterleaved( VBO, positions, colours );
 }
 
 
 
-void Player::draw( mat4 &worldToViewTransform )
+void Player::draw( vec2 pos, mat4 &worldToViewTransform )
 
 {
   // Provide MVP to GPU program
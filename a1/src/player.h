@@ -20,16 +20,13 @@ class Player {
   vec2 pos; // position
 
   Player( vec2 _pos ) {
-
     pos = _pos;
-
-    if (db == NULL)
-      generateVAOs();
   }
 
-  void generateVAOs();
-  void draw( mat4 &worldToViewTransform );
+  static void generateVAOs();
+  static void draw( vec2 pos, mat4 &worldToViewTransform );
   void moveTo( vec2 pos );
+  static vec2 clampToPlayerArea( vec2 pos );
   void fire();
 };
 
@@ -0,0 +1,84 @@
+// pool.cpp
+
+
+#include "pool.h"
+
+
+long poolHeapAllocations = 0;
+
+
+BlockPool::BlockPool( size_t _blockSize )
+
+{
+  // A free block has to hold the free list's pointer, and each block
+  // has to be aligned for whatever is put in it
+
+  blockSize = (_blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : _blockSize);
+  blockSize = (blockSize + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+  blocksPerChunk = POOL_CHUNK_BYTES / blockSize;
+  if (blocksPerChunk < 1)
+    blocksPerChunk = 1;
+
+  numBlocks = 0;
+  freeList = NULL;
+}
+
+
+BlockPool::~BlockPool()
+
+{
+  for (int i=0; i<chunks.size(); i++)
+    delete [] chunks[i];
+}
+
+
+// Take another chunk from the heap and put its blocks on the free
+// list
+
+void BlockPool::addChunk()
+
+{
+  char *chunk = new char[ blocksPerChunk * blockSize ];
+  chunks.add( chunk );
+  poolHeapAllocations++;
+
+  for (int i=blocksPerChunk-1; i>=0; i--) {
+    FreeBlock *b = (FreeBlock *) (chunk + i * blockSize);
+    b->next = freeList;
+    freeList = b;
+  }
+
+  numBlocks += blocksPerChunk;
+}
+
+
+void *BlockPool::alloc()
+
+{
+  if (freeList == NULL)
+    addChunk();
+
+  FreeBlock *b = freeList;
+  freeList = b->next;
+
+  return b;
+}
+
+
+void BlockPool::free( void *block )
+
+{
+  FreeBlock *b = (FreeBlock *) block;
+
+  b->next = freeList;
+  freeList = b;
+}
+
+
+void BlockPool::reserve( int n )
+
+{
+  while (numBlocks < n)
+    addChunk();
+}
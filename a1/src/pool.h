@@ -0,0 +1,99 @@
+// pool.h
+//
+// Pools of fixed-size blocks, for the memory that entities take and
+// give back during play, so that a split centipede or a new dart
+// doesn't go to the heap.
+//
+// A BlockPool hands out blocks of one size.  Blocks are carved from
+// chunks of several blocks each, and the free blocks are kept on an
+// intrusive free list: each free block holds a pointer to the next one
+// in its first bytes, so the list takes no memory of its own.  Chunks
+// go back to the heap only when the pool is destroyed.  So once a pool
+// has as many blocks as are in use at the busiest time (or as many as
+// were reserved), alloc() and free() just unlink and relink a block.
+//
+// The entities themselves are kept by value in SlotMaps (slotmap.h),
+// which recycle their slots through a free list in the same way, and
+// which can reserve room for the most entities of each type that the
+// world config allows.
+//
+// poolHeapAllocations counts every trip to the heap made by the pools
+// and by the SlotMaps' storage, so that it can be checked that steady
+// play makes none.  The pools aren't thread safe; they're used by the
+// simulation thread only.
+
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "seq.h"
+
+#include <stddef.h>
+
+#define POOL_CHUNK_BYTES 65536 // size of the chunks a pool's blocks are carved from (at least one block)
+
+
+extern long poolHeapAllocations;
+
+
+class BlockPool {
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  size_t blockSize;
+  int blocksPerChunk;
+  int numBlocks;                // in all of the chunks
+
+  seq<char *> chunks;
+  FreeBlock *freeList;
+
+  void addChunk();
+
+ public:
+
+  BlockPool( size_t blockSize );
+  ~BlockPool();
+
+  void *alloc();
+  void free( void *block );
+
+  void reserve( int n );        // have at least 'n' blocks, in use or free
+};
+
+
+// Arrays of a power-of-two number of T's, from a BlockPool for each
+// size.  T must not need constructing or destroying.
+
+template<class T> class PowerOfTwoPool {
+
+  BlockPool *pools[32];         // by log2 of the number of elements
+
+  BlockPool &pool( long n ) {
+    int k = 0;
+    while ((1L << k) < n)
+      k++;
+    if (pools[k] == NULL)
+      pools[k] = new BlockPool( (1L << k) * sizeof(T) );
+    return *pools[k];
+  }
+
+ public:
+
+  PowerOfTwoPool() {
+    for (int k=0; k<32; k++)
+      pools[k] = NULL;
+  }
+
+  ~PowerOfTwoPool() {
+    for (int k=0; k<32; k++)
+      delete pools[k];
+  }
+
+  T *alloc( long n )               { return (T *) pool( n ).alloc(); }
+  void free( T *array, long n )    { pool( n ).free( array ); }
+  void reserve( long n, int count ) { pool( n ).reserve( count ); }
+};
+
+#endif
@@ -0,0 +1,400 @@
+// profiler.cpp
+//
+// See profiler.h.  Nothing in here is compiled unless PROFILE is
+// defined.
+
+
+#ifdef PROFILE
+
+#include "profiler.h"
+#include "spscring.h"
+#include "strokefont.h"
+#include "trace.h"
+#include "arena.h"
+
+#include <atomic>
+#include <algorithm>
+
+#define OVERLAY_TEXT_SIZE 0.025   // height of overlay text in viewing coordinates
+#define OVERLAY_X        -0.95
+#define OVERLAY_Y         0.75
+
+#define STAGE_SMOOTHING   0.05    // weight of the newest frame in each stage's running average
+
+
+// ---------------- Producer side (any thread) ----------------
+
+
+static chrono::steady_clock::time_point profileStart = chrono::steady_clock::now();
+
+
+ProfileTime profileClock()
+
+{
+  return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now() - profileStart ).count();
+}
+
+
+struct ProfileThread {
+  int         index;
+  const char *name;
+  SPSCRing<ProfileSample,PROFILE_RING_SIZE> ring;
+  std::atomic<unsigned int> dropped; // samples lost because the ring was full
+};
+
+static std::atomic<ProfileThread *> profileThreads[ MAX_PROFILE_THREADS ];
+static std::atomic<int> numProfileThreads( 0 );
+
+static thread_local ProfileThread *thisThread = NULL;
+static thread_local int scopeDepth = 0;
+
+
+// Create a new lane with its own ring.  Returns NULL if there are too
+// many lanes.
+
+static ProfileThread *newLane( const char *name )
+
+{
+  int i = numProfileThreads.fetch_add( 1 );
+
+  if (i >= MAX_PROFILE_THREADS) {
+    cerr << "profiler: More than " << MAX_PROFILE_THREADS << " lanes; " << name << " is not profiled" << endl;
+    return NULL;
+  }
+
+  ProfileThread *t = new ProfileThread;
+  t->index = i;
+  t->name = name;
+  t->dropped = 0;
+
+  profileThreads[i] = t;
+  return t;
+}
+
+
+// Give the calling thread its own lane.  Threads that don't register
+// are registered (as "thread") when they first close a scope.
+
+void profilerRegisterThread( const char *name )
+
+{
+  if (!thisThread)
+    thisThread = newLane( name );
+}
+
+
+// A lane that isn't a thread, for spans measured some other way (e.g.
+// on the GPU).  Spans for it are added with profilerAddSpan(), always
+// from the same thread.
+
+int profilerRegisterLane( const char *name )
+
+{
+  ProfileThread *t = newLane( name );
+
+  return (t ? t->index : -1);
+}
+
+
+void profilerAddSpan( int lane, const char *name, const char *category, ProfileTime start, ProfileTime end )
+
+{
+  if (lane < 0)
+    return;
+
+  ProfileSample s;
+
+  s.name = name;
+  s.category = category;
+  s.start = start;
+  s.end = end;
+  s.depth = 0;
+  s.allocs = 0;
+  s.allocBytes = 0;
+
+  ProfileThread *t = profileThreads[ lane ];
+
+  if (!t->ring.push( s ))
+    t->dropped++;
+}
+
+
+ProfileScope::ProfileScope( const char *_name, const char *_category )
+
+{
+  name = _name;
+  category = _category;
+  scopeDepth++;
+  allocStart = threadAllocCount();
+  start = profileClock();
+}
+
+
+ProfileScope::~ProfileScope()
+
+{
+  ProfileSample s;
+
+  s.end = profileClock();
+  s.start = start;
+  s.name = name;
+  s.category = category;
+  s.depth = --scopeDepth;
+
+  AllocCount allocEnd = threadAllocCount();
+  s.allocs = allocEnd.allocs - allocStart.allocs;
+  s.allocBytes = allocEnd.bytes - allocStart.bytes;
+
+  if (!thisThread) {
+    profilerRegisterThread( "thread" );
+    if (!thisThread)
+      return;
+  }
+
+  if (!thisThread->ring.push( s ))
+    thisThread->dropped++;
+}
+
+
+// ---------------- Consumer side (the thread that calls PROFILE_FRAME) ----------------
+
+
+struct StageStats {
+  const char *name;
+  int         thread;
+  int         depth;
+  ProfileTime firstStart;       // start of the first sample (for display order)
+  double      frameMs;          // total in the current frame
+  double      avgMs;            // running average per frame
+  double      frameAllocs;      // heap allocations in the current frame
+  double      avgAllocs;        //   and their running average
+};
+
+static StageStats stages[ MAX_PROFILE_STAGES ];
+static int numStages = 0;
+
+static float frameTimes[ PROFILE_HISTORY ]; // in ms
+static int numFrameTimes = 0;
+static int nextFrameTime = 0;
+
+static ProfileTime lastFrameEnd = 0;
+
+static AllocCount lastFrameEndAllocs;  // all threads' allocations at the end of the last frame
+static AllocCount frameAllocs;         //   and the number made during it
+
+static bool overlayOn = false;
+
+static TraceWriter trace;
+static bool traceNamed[ MAX_PROFILE_THREADS ]; // lane already labelled in the trace
+static unsigned int frameNumber = 0;
+
+
+static bool stageBefore( const StageStats &a, const StageStats &b )
+
+{
+  if (a.thread != b.thread)
+    return a.thread < b.thread;
+  return a.firstStart < b.firstStart;
+}
+
+
+static StageStats *findStage( int thread, ProfileSample &s )
+
+{
+  for (int i=0; i<numStages; i++)
+    if (stages[i].thread == thread && stages[i].depth == s.depth && strcmp( stages[i].name, s.name ) == 0)
+      return &stages[i];
+
+  if (numStages == MAX_PROFILE_STAGES)
+    return NULL;
+
+  StageStats &st = stages[ numStages++ ];
+
+  st.name = s.name;
+  st.thread = thread;
+  st.depth = s.depth;
+  st.firstStart = s.start;
+  st.frameMs = 0;
+  st.avgMs = 0;
+  st.frameAllocs = 0;
+  st.avgAllocs = 0;
+
+  return &st;
+}
+
+
+// Drain every thread's ring and fold this frame into the averages
+
+void profilerEndFrame()
+
+{
+  PROFILE_SCOPE( "profiler" );
+
+  ProfileTime now = profileClock();
+
+  AllocCount allocs = totalAllocCount();
+
+  frameAllocs.allocs = allocs.allocs - lastFrameEndAllocs.allocs;
+  frameAllocs.bytes = allocs.bytes - lastFrameEndAllocs.bytes;
+  lastFrameEndAllocs = allocs;
+
+  if (trace.isOpen() && lastFrameEnd > 0 && thisThread) {
+    char name[32];
+    sprintf( name, "frame %u", frameNumber );
+    trace.span( name, "frame", thisThread->index, lastFrameEnd, now - lastFrameEnd, frameAllocs.allocs, frameAllocs.bytes );
+  }
+
+  frameNumber++;
+
+  if (lastFrameEnd > 0) {
+    frameTimes[ nextFrameTime ] = (now - lastFrameEnd) / 1.0e6;
+    nextFrameTime = (nextFrameTime + 1) % PROFILE_HISTORY;
+    if (numFrameTimes < PROFILE_HISTORY)
+      numFrameTimes++;
+  }
+
+  lastFrameEnd = now;
+
+  for (int i=0; i<numStages; i++) {
+    stages[i].frameMs = 0;
+    stages[i].frameAllocs = 0;
+  }
+
+  int prevNumStages = numStages;
+
+  for (int t=0; t<MAX_PROFILE_THREADS; t++) {
+
+    ProfileThread *thread = profileThreads[t];
+    if (!thread)
+      continue;
+
+    if (trace.isOpen() && !traceNamed[t]) {
+      trace.threadName( t, thread->name );
+      traceNamed[t] = true;
+    }
+
+    ProfileSample s;
+    while (thread->ring.pop( s )) {
+
+      StageStats *st = findStage( t, s );
+      if (st) {
+        st->frameMs += (s.end - s.start) / 1.0e6;
+        st->frameAllocs += s.allocs;
+      }
+
+      if (trace.isOpen())
+        trace.span( s.name, s.category, t, s.start, s.end - s.start, s.allocs, s.allocBytes );
+    }
+  }
+
+  for (int i=0; i<numStages; i++) {
+    stages[i].avgMs += STAGE_SMOOTHING * (stages[i].frameMs - stages[i].avgMs);
+    stages[i].avgAllocs += STAGE_SMOOTHING * (stages[i].frameAllocs - stages[i].avgAllocs);
+  }
+
+  if (numStages != prevNumStages)
+    sort( stages, stages+numStages, stageBefore );
+}
+
+
+void profilerToggleOverlay()
+
+{
+  overlayOn = !overlayOn;
+}
+
+
+// Return the p^th percentile of the frame times, in ms
+
+static float frameTimePercentile( float p )
+
+{
+  if (numFrameTimes == 0)
+    return 0;
+
+  float sorted[ PROFILE_HISTORY ];
+
+  for (int i=0; i<numFrameTimes; i++)
+    sorted[i] = frameTimes[i];
+
+  sort( sorted, sorted+numFrameTimes );
+
+  return sorted[ std::min( numFrameTimes-1, (int) (p * numFrameTimes) ) ];
+}
+
+
+// The overlay's text, built in the frame's arena
+
+static const char *overlayText()
+
+{
+  FrameString str( frameArena );
+
+  int thread = -1;
+
+  for (int i=0; i<numStages; i++) {
+
+    if (stages[i].thread != thread) {
+      thread = stages[i].thread;
+      ProfileThread *t = profileThreads[ thread ];
+      str.printf( "%s", t->name );
+      if (t->dropped > 0)
+        str.printf( " (%u dropped)", (unsigned int) t->dropped );
+      str.printf( "\n" );
+    }
+
+    int indent = 2 * (stages[i].depth+1);
+    str.printf( "%*s%-*s%7.3f ms", indent, "", std::max( 24 - indent, 0 ), stages[i].name, stages[i].avgMs );
+    if (stages[i].avgAllocs >= 0.05)
+      str.printf( "  %.1f allocs", stages[i].avgAllocs );
+    str.printf( "\n" );
+  }
+
+  str.printf( "frame p50 %.3f  p95 %.3f  p99 %.3f ms\n",
+              frameTimePercentile( 0.50 ), frameTimePercentile( 0.95 ), frameTimePercentile( 0.99 ) );
+
+  str.printf( "last frame %llu allocs (%llu bytes)", frameAllocs.allocs, frameAllocs.bytes );
+
+  return str.c_str();
+}
+
+
+void profilerDrawOverlay()
+
+{
+  if (!overlayOn)
+    return;
+
+  PROFILE_SCOPE( "overlay" );
+
+  fontGPUProg->activate();
+  drawStrokeString( overlayText(), OVERLAY_X, OVERLAY_Y, OVERLAY_TEXT_SIZE );
+  fontGPUProg->deactivate();
+}
+
+void profilerReport()
+
+{
+  cout << overlayText() << endl;
+}
+
+// Start sending spans to a trace file.  Spans are only collected
+// while frames are being ended, so this must be called on the thread
+// that calls PROFILE_FRAME(), or before that thread starts.
+
+bool profilerStartTrace( const char *filename )
+
+{
+  return trace.open( filename );
+}
+
+
+void profilerStopTrace()
+
+{
+  profilerEndFrame(); // collect any spans since the last frame
+
+  trace.close();
+}
+
+#endif
@@ -0,0 +1,112 @@
+// profiler.h
+//
+// A hierarchical CPU frame profiler.
+//
+// Put PROFILE_SCOPE( "name" ) at the top of a block to time the rest
+// of that block.  Each thread writes its timings into its own
+// lock-free ring (see spscring.h), so timing never takes a lock.
+// Once per frame, PROFILE_FRAME() drains the rings and updates the
+// per-stage averages and the frame-time history that the overlay
+// shows.  PROFILE_DRAW_OVERLAY() draws them with the stroke font and
+// PROFILE_REPORT() prints them (for headless runs).
+//
+// profilerStartTrace( file ) additionally sends every span, plus one
+// span per frame, to a Chrome trace-event file (see trace.h), with
+// one lane per thread.  Spans opened with PROFILE_GL_SCOPE are marked
+// as GL submission in the trace, and those opened with
+// PROFILE_JOB_SCOPE (by the job system: see jobs.h) as jobs.
+//
+// Each span also records the heap allocations that its thread made
+// inside it (see alloccount.h).  The overlay shows each stage's
+// average allocations per frame, and the allocations in the last
+// frame, and the trace gives the counts as the spans' arguments.
+//
+// The profiler is compiled in only when PROFILE is defined (e.g.
+// "make PROFILE=1").  Otherwise every macro below expands to nothing.
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef PROFILE
+
+#include "headers.h"
+#include "alloccount.h"
+
+#define MAX_PROFILE_THREADS  32
+#define PROFILE_RING_SIZE    4096 // samples per thread; must be a power of two
+#define MAX_PROFILE_STAGES   64
+#define PROFILE_HISTORY      512  // number of frame times kept for percentiles
+
+typedef unsigned long long ProfileTime; // nanoseconds since program start
+
+ProfileTime profileClock();
+
+
+// One timed span
+
+struct ProfileSample {
+  const char *name;
+  const char *category;         // "cpu" or "gl"
+  ProfileTime start;
+  ProfileTime end;
+  int         depth;            // nesting depth within its thread
+  unsigned long long allocs;    // heap allocations made in the span
+  unsigned long long allocBytes;
+};
+
+
+// Times the enclosing block
+
+class ProfileScope {
+
+  const char *name;
+  const char *category;
+  ProfileTime start;
+  AllocCount  allocStart;
+
+ public:
+
+  ProfileScope( const char *_name, const char *_category = "cpu" );
+  ~ProfileScope();
+};
+
+
+void profilerRegisterThread( const char *name );
+int  profilerRegisterLane( const char *name );
+void profilerAddSpan( int lane, const char *name, const char *category, ProfileTime start, ProfileTime end );
+void profilerEndFrame();
+void profilerToggleOverlay();
+void profilerDrawOverlay();
+void profilerReport();
+bool profilerStartTrace( const char *filename );
+void profilerStopTrace();
+
+#define PROFILE_CONCAT2(a,b) a ## b
+#define PROFILE_CONCAT(a,b)  PROFILE_CONCAT2(a,b)
+
+#define PROFILE_SCOPE(name)      ProfileScope PROFILE_CONCAT( profileScope, __LINE__ )( name )
+#define PROFILE_GL_SCOPE(name)   ProfileScope PROFILE_CONCAT( profileScope, __LINE__ )( name, "gl" )
+#define PROFILE_JOB_SCOPE(name)  ProfileScope PROFILE_CONCAT( profileScope, __LINE__ )( name, "job" )
+#define PROFILE_THREAD(name)     profilerRegisterThread( name )
+#define PROFILE_FRAME()          profilerEndFrame()
+#define PROFILE_TOGGLE_OVERLAY() profilerToggleOverlay()
+#define PROFILE_DRAW_OVERLAY()   profilerDrawOverlay()
+#define PROFILE_REPORT()         profilerReport()
+#define PROFILE_STOP_TRACE()     profilerStopTrace()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GL_SCOPE(name)
+#define PROFILE_JOB_SCOPE(name)
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+#define PROFILE_TOGGLE_OVERLAY()
+#define PROFILE_DRAW_OVERLAY()
+#define PROFILE_REPORT()
+#define PROFILE_STOP_TRACE()
+
+#endif
+
+#endif
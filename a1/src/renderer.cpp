@@ -0,0 +1,256 @@
+// renderer.cpp
+
+#include "renderer.h"
+#include "main.h"
+#include "strokefont.h"
+#include "vertexformat.h"
+#include "worldDefs.h"
+#include "centipede.h"
+#include "mushroom.h"
+#include "player.h"
+#include "dart.h"
+#include "spider.h"
+#include "profiler.h"
+#include "gputimer.h"
+#include "arena.h"
+
+
+#define TEXT_SIZE 0.06 // as a fraction of centre-to-top distance
+
+// Set up the renderer.  All of the shared geometry is built here, on
+// the thread that owns the GL context, rather than lazily when the
+// first instance of each object is created.
+
+Renderer::Renderer(GLFWwindow *w)
+
+{
+  window = w;
+  lateLatch = true;
+
+  Mushroom::generateVAOs();
+  Segment::generateVAOs();
+  Player::generateVAOs();
+  Dart::generateVAOs();
+  Spider::generateVAOs();
+
+  setWindowEdgeCoordinates();
+}
+
+// Draw the whole world, including its inhabitants.
+
+void Renderer::draw(RenderSnapshot &snap)
+
+{
+  GPU_PASS_BEGIN(GPU_PASS_CLEAR);
+
+  glClearColor(BACKGROUND_COLOUR.x, BACKGROUND_COLOUR.y, BACKGROUND_COLOUR.z, 0);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  GPU_PASS_END(GPU_PASS_CLEAR);
+
+  setWindowEdgeCoordinates();
+
+  mat4 VP = ortho(l, r, b, t, 0, 1);
+
+  // Draw everything
+
+  gpuProg->activate();
+
+  uploadPalette(gpuProg);
+
+  {
+    PROFILE_GL_SCOPE("mushrooms");
+    GPU_PASS_BEGIN(GPU_PASS_MUSHROOMS);
+
+    for (int i = 0; i < snap.mushrooms.size(); i++)
+      Mushroom::draw(snap.mushrooms[i].pos, snap.mushrooms[i].damage, VP);
+
+    GPU_PASS_END(GPU_PASS_MUSHROOMS);
+  }
+
+  {
+    PROFILE_GL_SCOPE("centipedes");
+    GPU_PASS_BEGIN(GPU_PASS_CENTIPEDES);
+
+    for (int i = 0; i < snap.segments.size(); i++)
+      Segment::draw(snap.segments[i].pos, snap.segments[i].dir, snap.segments[i].isHead, snap.segments[i].phase, VP);
+
+    GPU_PASS_END(GPU_PASS_CENTIPEDES);
+  }
+
+  GPU_PASS_BEGIN(GPU_PASS_ACTORS);
+
+  {
+    PROFILE_GL_SCOPE("spiders");
+
+    for (int i = 0; i < snap.spiders.size(); i++)
+      Spider::draw(snap.spiders[i].pos, snap.spiders[i].vel, VP);
+  }
+
+  // The player and darts go last, so that the cursor can be latched as
+  // late as possible.
+
+  drawPlayerAndDarts(snap, VP);
+
+  GPU_PASS_END(GPU_PASS_ACTORS);
+
+  GPU_PASS_BEGIN(GPU_PASS_HUD);
+  drawStatus(snap, VP);
+  GPU_PASS_END(GPU_PASS_HUD);
+
+  GPU_FRAME_END();
+}
+
+// Draw the player (at the late-latched position, if enabled) and the
+// darts
+
+void Renderer::drawPlayerAndDarts(RenderSnapshot &snap, mat4 &VP)
+
+{
+  PROFILE_GL_SCOPE("player and darts");
+
+  vec2 playerPos = snap.playerPos;
+
+  if (lateLatch)
+  {
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    playerPos = Player::clampToPlayerArea(windowToWorld(window, x, y));
+  }
+
+  Player::draw(playerPos, VP);
+
+  for (int i = 0; i < snap.darts.size(); i++)
+    Dart::draw(snap.darts[i], VP);
+}
+
+// Draw the lives remaining, score, level and any message
+
+void Renderer::drawStatus(RenderSnapshot &snap, mat4 &VP)
+
+{
+  PROFILE_GL_SCOPE("text");
+
+  // Show lives remaining in upper-left corner
+
+  for (int i = 0; i < snap.livesRemaining - 1; i++)
+    Player::draw(vec2(WORLD_LEFT_EDGE + 1 * worldConfig.colSpacing + i * 0.7 * worldConfig.colSpacing, TOP_TEXT_Y + TEXT_SIZE / 2.0), VP);
+
+  // Done drawing geometry
+
+  gpuProg->deactivate();
+
+  // Draw status at top
+
+  fontGPUProg->activate();
+
+  if (!snap.gameOver)
+  { // game is still running
+
+    { // Draw score in middle
+
+      FrameString str(frameArena);
+      str.printf("Score %d", snap.score);
+
+      drawStrokeString(str.c_str(),
+                       -((str.size() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y, // centre the string at top of window
+                       TEXT_SIZE);
+    }
+
+    { // Draw level or right
+
+      FrameString str(frameArena);
+      str.printf("Level %d", snap.level + 1);
+
+      drawStrokeString(str.c_str(),
+                       WORLD_RIGHT_EDGE + worldConfig.colSpacing - ((str.size() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y, // centre the string at top of window
+                       TEXT_SIZE);
+    }
+  }
+  else
+  { // game is over
+
+    FrameString str(frameArena);
+    str.printf("GAME OVER     Score %d     Press s to start", snap.score);
+
+    drawStrokeString(str.c_str(),
+                     WORLD_LEFT_EDGE - 2.5 * worldConfig.colSpacing, TOP_TEXT_Y, // centre the string at top of window
+                     TEXT_SIZE);
+  }
+
+  // Show any message for which we're pausing on a line below the top line
+
+  if (snap.pauseForMessage)
+  {
+
+    if (snap.playerDied)
+    {
+
+      // pausing after player died
+
+      const char *str = "YOU DIED";
+      drawStrokeString(str,
+                       -((strlen(str) - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y - worldConfig.rowSpacing,
+                       TEXT_SIZE);
+    }
+    else if (snap.goToNextLevel)
+    {
+
+      // pausing after level ended
+
+      const char *str = "END OF LEVEL";
+      drawStrokeString(str,
+                       -((strlen(str) - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y - worldConfig.rowSpacing,
+                       TEXT_SIZE);
+    }
+  }
+
+  fontGPUProg->deactivate();
+}
+
+// Convert a window position (in screen coordinates, as given by GLFW)
+// into a world position.
+
+vec2 Renderer::windowToWorld(GLFWwindow *w, double x, double y)
+
+{
+  int winX, winY;
+  glfwGetWindowSize(w, &winX, &winY);
+
+  float worldX = ((2.0f * x) / winX) - 1.0f;
+  float worldY = ((-2.0f * y) / winY) + 1.0f;
+
+  return vec2(worldX, worldY);
+}
+
+// Find the coordinates of the window edges so that the game window
+// fits in an area with coordinates [-GAME_ASPECT,+GAME_ASPECT] x [-1,1].
+
+void Renderer::setWindowEdgeCoordinates()
+
+{
+  int width, height;
+  glfwGetFramebufferSize(window, &width, &height);
+
+  float windowAspect = width / (float)height; // aspect ratio of screen window
+  float totalAspect = GAME_ASPECT;
+
+  if (totalAspect > windowAspect)
+  { // game should resize to fit horizontally in screen window
+
+    l = -GAME_ASPECT;
+    r = -l;
+
+    b = l / windowAspect;
+    t = -b;
+  }
+  else
+  { // game should resize vertically to fit  in screen window
+
+    b = -1;
+    t = +1;
+
+    l = b * windowAspect;
+    r = -l;
+  }
+}
@@ -0,0 +1,37 @@
+// renderer.h
+//
+// Draws RenderSnapshots.  The Renderer lives on the thread that owns
+// the GL context; it never touches the live World.
+
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "headers.h"
+#include "snapshot.h"
+
+
+class Renderer
+{
+  GLFWwindow *window;
+
+public:
+  float l, r, b, t; // coordinates of window edges
+
+  // With 'lateLatch' on, the player is drawn at the cursor position
+  // sampled just before the player is drawn, rather than at the
+  // position in the snapshot (which is at least one tick old).
+
+  bool lateLatch;
+
+  Renderer(GLFWwindow *w);
+
+  void draw(RenderSnapshot &snap);
+  void drawPlayerAndDarts(RenderSnapshot &snap, mat4 &VP);
+  void drawStatus(RenderSnapshot &snap, mat4 &VP);
+  void setWindowEdgeCoordinates();
+
+  static vec2 windowToWorld(GLFWwindow *w, double x, double y);
+};
+
+#endif
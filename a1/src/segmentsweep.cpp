@@ -0,0 +1,367 @@
+// segmentsweep.cpp
+
+
+#include "segmentsweep.h"
+#include "headers.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define SWEEP_X86
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
+// GCC and Clang compile a function for an instruction set that isn't
+// enabled for the whole file when it is marked with a target.  MSVC
+// compiles the intrinsics regardless.
+
+#if defined(SWEEP_X86) && defined(__GNUC__)
+  #define TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+  #define TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#else
+  #define TARGET_AVX2
+  #define TARGET_SSE2
+#endif
+
+
+// A kernel does one batch of darts: SWEEP_BATCH of them for
+// closestSegmentsAhead(), or one for closestSegmentAhead().  'radius'
+// has already been converted to the float threshold for
+// "perp <= radius".
+
+typedef void (*SweepKernel)( const float *dartX, const float *dartY,
+                             const float *segX, const float *segY, int numSegs,
+                             float radius, int *closest, float *dist );
+
+
+// Segments [from,to) for one dart, continuing from 'best' and
+// 'bestIndex'
+
+static inline void sweepRange( float dartX, float dartY, const float *segX, const float *segY,
+                               int from, int to, float radius, float &best, int &bestIndex )
+
+{
+  for (int i=from; i<to; i++) {
+    float along = segY[i] - dartY;
+    float perp = fabs( segX[i] - dartX );
+
+    bool closer = (along > 0) & (perp <= radius) & (along < best);
+
+    best = (closer ? along : best);
+    bestIndex = (closer ? i : bestIndex);
+  }
+}
+
+
+template<int BATCH>
+static void sweepScalar( const float *dartX, const float *dartY,
+                         const float *segX, const float *segY, int numSegs,
+                         float radius, int *closest, float *dist )
+
+{
+  for (int d=0; d<BATCH; d++) {
+    dist[d] = MAXFLOAT;
+    closest[d] = -1;
+    sweepRange( dartX[d], dartY[d], segX, segY, 0, numSegs, radius, dist[d], closest[d] );
+  }
+}
+
+
+#ifdef SWEEP_X86
+
+// Reduce the per-lane minima of one dart: the smallest distance, and
+// of equal distances the lowest index
+
+static inline void reduceLanes( const float *best, const int *bestIndex, int lanes, float &dist, int &closest )
+
+{
+  dist = MAXFLOAT;
+  closest = -1;
+
+  for (int l=0; l<lanes; l++) {
+    bool better = (best[l] < dist) | ((best[l] == dist) & (bestIndex[l] >= 0) & ((unsigned) bestIndex[l] < (unsigned) closest));
+    dist = (better ? best[l] : dist);
+    closest = (better ? bestIndex[l] : closest);
+  }
+}
+
+
+template<int BATCH>
+TARGET_AVX2
+static void sweepAVX2( const float *dartX, const float *dartY,
+                       const float *segX, const float *segY, int numSegs,
+                       float radius, int *closest, float *dist )
+
+{
+  const __m256 signBit = _mm256_set1_ps( -0.0f );
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 r = _mm256_set1_ps( radius );
+  const __m256i eight = _mm256_set1_epi32( 8 );
+
+  __m256 dx[BATCH], dy[BATCH], best[BATCH];
+  __m256i bestIndex[BATCH];
+
+  for (int d=0; d<BATCH; d++) {
+    dx[d] = _mm256_set1_ps( dartX[d] );
+    dy[d] = _mm256_set1_ps( dartY[d] );
+    best[d] = _mm256_set1_ps( MAXFLOAT );
+    bestIndex[d] = _mm256_set1_epi32( -1 );
+  }
+
+  __m256i index = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+  int i;
+
+  for (i=0; i+8<=numSegs; i+=8) {
+
+    __m256 x = _mm256_loadu_ps( segX + i );
+    __m256 y = _mm256_loadu_ps( segY + i );
+
+    for (int d=0; d<BATCH; d++) {
+      __m256 along = _mm256_sub_ps( y, dy[d] );
+      __m256 perp = _mm256_andnot_ps( signBit, _mm256_sub_ps( x, dx[d] ) );
+
+      __m256 closer = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( along, zero, _CMP_GT_OQ ),
+                                                    _mm256_cmp_ps( perp, r, _CMP_LE_OQ ) ),
+                                     _mm256_cmp_ps( along, best[d], _CMP_LT_OQ ) );
+
+      best[d] = _mm256_blendv_ps( best[d], along, closer );
+      bestIndex[d] = _mm256_blendv_epi8( bestIndex[d], index, _mm256_castps_si256( closer ) );
+    }
+
+    index = _mm256_add_epi32( index, eight );
+  }
+
+  for (int d=0; d<BATCH; d++) {
+    float laneBest[8];
+    int laneIndex[8];
+
+    _mm256_storeu_ps( laneBest, best[d] );
+    _mm256_storeu_si256( (__m256i *) laneIndex, bestIndex[d] );
+
+    reduceLanes( laneBest, laneIndex, 8, dist[d], closest[d] );
+
+    sweepRange( dartX[d], dartY[d], segX, segY, i, numSegs, radius, dist[d], closest[d] );
+  }
+}
+
+
+// SSE2 has no blend instruction, so the blends are and/andnot/or
+
+template<int BATCH>
+TARGET_SSE2
+static void sweepSSE2( const float *dartX, const float *dartY,
+                       const float *segX, const float *segY, int numSegs,
+                       float radius, int *closest, float *dist )
+
+{
+  const __m128 signBit = _mm_set1_ps( -0.0f );
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 r = _mm_set1_ps( radius );
+  const __m128i four = _mm_set1_epi32( 4 );
+
+  __m128 dx[BATCH], dy[BATCH], best[BATCH];
+  __m128i bestIndex[BATCH];
+
+  for (int d=0; d<BATCH; d++) {
+    dx[d] = _mm_set1_ps( dartX[d] );
+    dy[d] = _mm_set1_ps( dartY[d] );
+    best[d] = _mm_set1_ps( MAXFLOAT );
+    bestIndex[d] = _mm_set1_epi32( -1 );
+  }
+
+  __m128i index = _mm_setr_epi32( 0, 1, 2, 3 );
+
+  int i;
+
+  for (i=0; i+4<=numSegs; i+=4) {
+
+    __m128 x = _mm_loadu_ps( segX + i );
+    __m128 y = _mm_loadu_ps( segY + i );
+
+    for (int d=0; d<BATCH; d++) {
+      __m128 along = _mm_sub_ps( y, dy[d] );
+      __m128 perp = _mm_andnot_ps( signBit, _mm_sub_ps( x, dx[d] ) );
+
+      __m128 closer = _mm_and_ps( _mm_and_ps( _mm_cmpgt_ps( along, zero ), _mm_cmple_ps( perp, r ) ),
+                                  _mm_cmplt_ps( along, best[d] ) );
+      __m128i closerInt = _mm_castps_si128( closer );
+
+      best[d] = _mm_or_ps( _mm_and_ps( closer, along ), _mm_andnot_ps( closer, best[d] ) );
+      bestIndex[d] = _mm_or_si128( _mm_and_si128( closerInt, index ), _mm_andnot_si128( closerInt, bestIndex[d] ) );
+    }
+
+    index = _mm_add_epi32( index, four );
+  }
+
+  for (int d=0; d<BATCH; d++) {
+    float laneBest[4];
+    int laneIndex[4];
+
+    _mm_storeu_ps( laneBest, best[d] );
+    _mm_storeu_si128( (__m128i *) laneIndex, bestIndex[d] );
+
+    reduceLanes( laneBest, laneIndex, 4, dist[d], closest[d] );
+
+    sweepRange( dartX[d], dartY[d], segX, segY, i, numSegs, radius, dist[d], closest[d] );
+  }
+}
+
+
+static bool cpuHasAVX2()
+
+{
+#if defined(__GNUC__)
+  return __builtin_cpu_supports( "avx2" );
+#elif defined(_MSC_VER)
+  int info[4];
+
+  __cpuid( info, 1 );
+  bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)); // OSXSAVE and AVX
+  if (!osSavesAVX || (_xgetbv( 0 ) & 6) != 6)                       // XMM and YMM state enabled
+    return false;
+
+  __cpuidex( info, 7, 0 );
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return false;
+#endif
+}
+
+
+static bool cpuHasSSE2()
+
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  return true; // part of x86-64
+#elif defined(__GNUC__)
+  return __builtin_cpu_supports( "sse2" );
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid( info, 1 );
+  return (info[3] & (1 << 26)) != 0;
+#else
+  return false;
+#endif
+}
+
+#endif
+
+
+struct KernelChoice {
+  const char *name;
+  SweepKernel batch;            // SWEEP_BATCH darts
+  SweepKernel single;           // one dart
+};
+
+
+static KernelChoice chooseKernel()
+
+{
+#ifdef SWEEP_X86
+  if (cpuHasAVX2())
+    return { "avx2", sweepAVX2<SWEEP_BATCH>, sweepAVX2<1> };
+  if (cpuHasSSE2())
+    return { "sse2", sweepSSE2<SWEEP_BATCH>, sweepSSE2<1> };
+#endif
+  return { "scalar", sweepScalar<SWEEP_BATCH>, sweepScalar<1> };
+}
+
+
+static KernelChoice kernel = chooseKernel();
+
+
+const char *sweepKernelName()
+
+{
+  return kernel.name;
+}
+
+
+bool useSweepKernel( const char *name )
+
+{
+  if (strcmp( name, "scalar" ) == 0) {
+    kernel = { "scalar", sweepScalar<SWEEP_BATCH>, sweepScalar<1> };
+    return true;
+  }
+
+#ifdef SWEEP_X86
+  if (strcmp( name, "sse2" ) == 0 && cpuHasSSE2()) {
+    kernel = { "sse2", sweepSSE2<SWEEP_BATCH>, sweepSSE2<1> };
+    return true;
+  }
+
+  if (strcmp( name, "avx2" ) == 0 && cpuHasAVX2()) {
+    kernel = { "avx2", sweepAVX2<SWEEP_BATCH>, sweepAVX2<1> };
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+
+// The original test is "perp < radius" with 'radius' a double.  For a
+// float 'perp', that's "perp <= r" for the largest float r below
+// 'radius'.
+
+static float perpThreshold( double radius )
+
+{
+  float r = radius;
+  if (r >= radius)
+    r = nextafterf( r, 0 );
+
+  return r;
+}
+
+
+void closestSegmentsAhead( const float *dartX, const float *dartY, int numDarts,
+                           const float *segX, const float *segY, int numSegs,
+                           double radius, int *closest, float *dist )
+
+{
+  float r = perpThreshold( radius );
+
+  for (int d=0; d<numDarts; d+=SWEEP_BATCH) {
+
+    // A partial batch is padded with darts that are above everything
+
+    float batchX[SWEEP_BATCH], batchY[SWEEP_BATCH];
+    int batchClosest[SWEEP_BATCH];
+    float batchDist[SWEEP_BATCH];
+
+    for (int b=0; b<SWEEP_BATCH; b++) {
+      batchX[b] = (d+b < numDarts ? dartX[d+b] : 0);
+      batchY[b] = (d+b < numDarts ? dartY[d+b] : MAXFLOAT);
+    }
+
+    kernel.batch( batchX, batchY, segX, segY, numSegs, r, batchClosest, batchDist );
+
+    for (int b=0; b<SWEEP_BATCH && d+b<numDarts; b++) {
+      closest[d+b] = batchClosest[b];
+      dist[d+b] = batchDist[b];
+    }
+  }
+}
+
+
+void closestSegmentAhead( float dartX, float dartY,
+                          const float *segX, const float *segY, int numSegs,
+                          double radius, int &closest, float &dist,
+                          const int *ids )
+
+{
+  float r = perpThreshold( radius );
+
+  kernel.single( &dartX, &dartY, segX, segY, numSegs, r, &closest, &dist );
+
+  // Of the segments as close as the one found, take the lowest id
+
+  if (ids != NULL && closest >= 0)
+    for (int i=0; i<numSegs; i++)
+      if (ids[i] < ids[closest] && segY[i] - dartY == dist && fabs( segX[i] - dartX ) <= r)
+        closest = i;
+}
@@ -0,0 +1,58 @@
+// segmentsweep.h
+//
+// The dart-versus-segment sweep, as a kernel over packed arrays of
+// segment positions: those of the SegmentStore, or those of one cell
+// of the segment grid (see uniformgrid.h) in World::updateDarts.
+//
+// For each dart, closestSegmentsAhead() finds the segment that is
+// closest ahead of it: above it, and within 'radius' of its column.
+// That is the test of the original scalar loop.  Of segments at the
+// same distance ahead, the one with the lowest index wins.
+//
+// The darts are done in batches of SWEEP_BATCH, so that each block of
+// segment positions is loaded once per batch.  Each dart keeps a
+// running minimum per SIMD lane, which is updated with compares and
+// blends (no branches); the lanes are reduced at the end.  There are
+// three versions of the kernel, chosen at run time by what the CPU
+// supports:
+//
+//   avx2    8 segments at a time
+//   sse2    4 segments at a time
+//   scalar  one at a time (and on CPUs that aren't x86)
+//
+// A hole left in the store by a hit segment has a posY of
+// SEGMENT_HOLE_Y (see centipede.h), so it is never ahead of a dart.
+
+
+#ifndef SEGMENTSWEEP_H
+#define SEGMENTSWEEP_H
+
+#include <cstddef>
+
+#define SWEEP_BATCH 4 // darts per pass over the segments
+
+
+// Sets closest[d] to the index of the closest segment ahead of dart d
+// at (dartX[d], dartY[d]), or to -1 if there's none, and dist[d] to
+// how far ahead it is.
+
+void closestSegmentsAhead( const float *dartX, const float *dartY, int numDarts,
+                           const float *segX, const float *segY, int numSegs,
+                           double radius, int *closest, float *dist );
+
+// The same for one dart.  If 'ids' is given, then of segments at the
+// same distance ahead, the one with the lowest ids[i] wins instead.
+
+void closestSegmentAhead( float dartX, float dartY,
+                          const float *segX, const float *segY, int numSegs,
+                          double radius, int &closest, float &dist,
+                          const int *ids = NULL );
+
+// The kernel in use ("avx2", "sse2" or "scalar"), and a way to choose
+// another (for the benchmarks).  useSweepKernel() returns false if
+// this CPU can't run the one named.
+
+const char *sweepKernelName();
+bool useSweepKernel( const char *name );
+
+#endif
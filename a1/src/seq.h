@@ -9,25 +9,44 @@
  *   CONSTRUCTORS
  *
  *     seq()               Create an empty sequence
+ *     seq( n )            Create an empty sequence with room for n elements
  *
  *   PUBLIC FUNCTIONS
  *
- *     add( x )            Add x to the end of the sequence
+ *     add( x )            Add x to the end of the sequence (moving it if it's a temporary)
+ *     emplace( args )     Add an element made from args to the end of the sequence
  *     remove()            Remove the last element of the sequence
  *     remove( i )         Remove the i^{th} element of the sequence (expensive)
  *     shift( i )          Shift right everything starting at position i
  *     operator [i]        Returns the i^{th} element (starting from 0)
  *     exists( x )         Return true if x exists in sequence, false otherwise
- *     clear()             Deletes the whole sequence
+ *     clear()             Remove all of the elements (keeping the storage)
+ *     truncate( n )       Keep only the first n elements (and all of the storage)
+ *     reserve( n )        Make room for n elements without growing again
+ *     compress()          Give back the storage beyond the last element
+ *     capacity()          The number of elements there's room for
  *     findIndex( x )      Find the index of element x, or -1 if it doesn't exist
+ *
+ * Only the elements in the sequence are constructed; the rest of the
+ * storage is raw memory.  A sequence can be moved, which takes its
+ * storage and leaves it empty, and elements are moved rather than
+ * copied when the storage grows.  Elements that are trivially
+ * copyable (numbers, pointers, vectors, ...) are kept in storage from
+ * malloc, which grows with realloc, and are copied with memcpy.
  */
 
 
 #ifndef SEQ_H
 #define SEQ_H
 
+#include "alloccount.h"
+
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 using namespace std;
 
@@ -38,31 +57,46 @@ template<class T> class seq {
   int numElements;
   T  *data;
 
+  static const bool trivial = std::is_trivially_copyable<T>::value;
+
+  void grow( int n );		// move the elements to storage for n elements
+  void grow() { grow( storageSize > 0 ? 2 * storageSize : 2 ); }
+  void freeStorage();
+
 public:
 
   seq() {			// constructor
-    storageSize = 2;
+    storageSize = 0;
     numElements = 0;
-    data = new T[ storageSize ];
+    data = NULL;
   }
 
   seq( int n ) {		// constructor
-    storageSize = n;
+    storageSize = 0;
     numElements = 0;
-    data = new T[ storageSize ];
+    data = NULL;
+    reserve( n );
   }
 
   ~seq() {			// destructor
-    delete [] data;
+    clear();
+    freeStorage();
   }
 
   seq( const seq<T> & source ) { // copy constructor
+    storageSize = 0;
+    numElements = 0;
+    data = NULL;
+    *this = source;
+  }
 
+  seq( seq<T> && source ) noexcept { // move constructor
     storageSize = source.storageSize;
     numElements = source.numElements;
-    data = new T[ storageSize ];
-    for (int i=0; i<numElements; i++)
-      data[i] = source.data[i];
+    data = source.data;
+    source.storageSize = 0;
+    source.numElements = 0;
+    source.data = NULL;
   }
 
   void remove() {
@@ -72,11 +106,31 @@ public:
     }
 
     numElements = numElements - 1;
+    data[ numElements ].~T();
+  }
+
+  void truncate( int n ) {
+    if (n < 0 || n > numElements) {
+      cerr << "truncate: Tried to truncate a sequence of " << numElements
+	   << " elements to " << n << " elements\n";
+      exit(-1);
+    }
+
+    if (!trivial)
+      for (int i=n; i<numElements; i++)
+	data[i].~T();
+
+    numElements = n;
   }
 
   void remove( int i );
   void shift( int i );
   void compress();
+  void reserve( int n );
+
+  int capacity() const {
+    return storageSize;
+  }
 
   T * array() { return data; }
 
@@ -99,55 +153,166 @@ public:
   }
 
   void clear() {
-    delete [] data;
-    storageSize = 1;
-    numElements = 0;
-    data = new T[ storageSize ];
+    truncate( 0 );
   }
 
   seq<T> & operator = (const seq<T> &source) { // assignment operator
+    if (this == &source)
+      return *this;
+
+    clear();
+    reserve( source.numElements );
+
+    if (trivial) {
+      if (source.numElements > 0)
+	memcpy( (void *) data, (const void *) source.data, source.numElements * sizeof(T) );
+    }
+    else
+      for (int i=0; i<source.numElements; i++)
+	new (&data[i]) T( source.data[i] );
+
+    numElements = source.numElements;
+    return *this;
+  }
+
+  seq<T> & operator = (seq<T> &&source) noexcept { // move assignment operator
+    if (this == &source)
+      return *this;
+
+    clear();
+    freeStorage();
+
     storageSize = source.storageSize;
     numElements = source.numElements;
-    delete [] data;
-    data = new T[ storageSize ];
-    for (int i=0; i<numElements; i++)
-      data[i] = source.data[i];
+    data = source.data;
+    source.storageSize = 0;
+    source.numElements = 0;
+    source.data = NULL;
     return *this;
   }
 
   void add( const T &x );
+  void add( T &&x );
+  template<class... Args> T & emplace( Args&&... args );
   int findIndex( const T &x );
   bool exists( const T &x );
 };
 
 
-// Add an element to the end of the sequence
+// Move the elements to storage for 'n' elements (n >= numElements)
 
 template<class T>
 void 
-seq<T>::add( const T &x )
+seq<T>::grow( int n )
 
 {
-  // No storage left?  If so, double the storage
+  if (trivial) {
 
-  if (numElements == storageSize) {
-    T *newData;
+    if (n == 0) {
+      free( (void *) data );
+      data = NULL;
+    }
+    else {
+      T *newData = (T *) realloc( (void *) data, n * sizeof(T) );
+      if (newData == NULL) {
+	cerr << "grow: Out of memory for a sequence of " << n << " elements\n";
+	exit(-1);
+      }
+      COUNT_ALLOCATION( n * sizeof(T) );
+      data = newData;
+    }
+  }
+  else {
+
+    T *newData = (n > 0 ? (T *) ::operator new( n * sizeof(T) ) : NULL);
+
+    for (int i=0; i<numElements; i++) {
+      new (&newData[i]) T( std::move( data[i] ) );
+      data[i].~T();
+    }
 
-    newData = new T[ storageSize * 2 ];
-    for (int i=0; i<storageSize; i++)
-      newData[i] = data[i];
-    storageSize = storageSize * 2;
-    delete [] data;
+    ::operator delete( data );
     data = newData;
   }
 
-  // Store the element in the next available position
+  storageSize = n;
+}
+
+
+template<class T>
+void 
+seq<T>::freeStorage()
+
+{
+  if (trivial)
+    free( (void *) data );
+  else
+    ::operator delete( data );
+
+  data = NULL;
+  storageSize = 0;
+}
+
+
+// Add an element to the end of the sequence.  If the storage has to
+// grow, the element is copied (or moved) out first, in case it's in
+// the sequence itself.
+
+template<class T>
+void 
+seq<T>::add( const T &x )
+
+{
+  if (numElements == storageSize) {
+    T copy( x );
+    grow();
+    new (&data[ numElements ]) T( std::move( copy ) );
+  }
+  else
+    new (&data[ numElements ]) T( x );
+
+  numElements++;
+}
+
+
+template<class T>
+void 
+seq<T>::add( T &&x )
+
+{
+  if (numElements == storageSize) {
+    T moved( std::move( x ) );
+    grow();
+    new (&data[ numElements ]) T( std::move( moved ) );
+  }
+  else
+    new (&data[ numElements ]) T( std::move( x ) );
 
-  data[ numElements ] = x;
   numElements++;
 }
 
 
+// Construct an element at the end of the sequence from 'args', and
+// return it
+
+template<class T>
+template<class... Args>
+T &
+seq<T>::emplace( Args&&... args )
+
+{
+  if (numElements == storageSize) {
+    T made( std::forward<Args>( args )... );
+    grow();
+    new (&data[ numElements ]) T( std::move( made ) );
+  }
+  else
+    new (&data[ numElements ]) T( std::forward<Args>( args )... );
+
+  return data[ numElements++ ];
+}
+
+
 // Compress the array
 
 template<class T>
@@ -155,17 +320,20 @@ void
 seq<T>::compress()
 
 {
-  T *newData;
+  if (numElements < storageSize)
+    grow( numElements );
+}
 
-  if (numElements == storageSize)
-    return;
 
-  newData = new T[ numElements ];
-  for (int i=0; i<numElements; i++)
-    newData[i] = data[i];
-  storageSize = numElements;
-  delete [] data;
-  data = newData;
+// Make room for 'n' elements
+
+template<class T>
+void 
+seq<T>::reserve( int n )
+
+{
+  if (n > storageSize)
+    grow( n );
 }
 
 
@@ -212,19 +380,16 @@ seq<T>::shift( int i )
     exit(-1);
   }
 
-  if (numElements == storageSize) {
-    T *newData;
+  if (numElements == storageSize)
+    grow();
 
-    newData = new T[ storageSize * 2 ];
-    for (int i=0; i<storageSize; i++)
-      newData[i] = data[i];
-    storageSize = storageSize * 2;
-    delete [] data;
-    data = newData;
-  }
+  new (&data[ numElements ]) T( std::move( data[ numElements-1 ] ) );
+
+  for (int j=numElements-1; j>i; j--)
+    data[j] = std::move( data[j-1] );
 
-  for (int j=numElements; j>i; j--)
-    data[j] = data[j-1];
+  if (!trivial)
+    data[i] = data[i+1];	// (so that a copy stays at i, as it does for trivial elements)
 
   numElements++;
 }
@@ -244,9 +409,9 @@ seq<T>::remove( int i )
   }
 
   for (int j=i; j<numElements-1; j++)
-    data[j] = data[j+1];
+    data[j] = std::move( data[j+1] );
 
-  numElements--;
+  remove();
 }
 
 
@@ -0,0 +1,221 @@
+// slotmap.h
+//
+// Storage for the entities of one type, addressed by generational
+// handles.
+//
+// The entities are kept by value in one contiguous ("dense") array,
+// so a pass over all of them is a linear walk through packed memory:
+//
+//     for (int i=0; i<darts.size(); i++)
+//       darts[i].pos = ...
+//
+// Removing an entity moves the last one into its place, which is
+// O(1) but changes the order of the dense array.  So a pointer or a
+// dense index is only good until the next add or remove.  Anything
+// that refers to an entity across changes to the map holds a Handle
+// instead.
+//
+// A handle names a slot, and the slot records where its entity is in
+// the dense array.  Each slot has a generation, which is bumped when
+// its entity is removed, so a handle to a removed entity is detected
+// (get() returns NULL) even after the slot has been reused.
+//
+// A handle is 32 bits: HANDLE_INDEX_BITS of slot index and the rest
+// generation.  Generation 0 is never used, so the handle with id 0 is
+// the null handle.
+//
+// A SlotMap is the pool for its type of entity (see pool.h): its
+// storage only grows, clear() keeps it, and reserve() sizes it up
+// front.  Each time the storage does have to grow, it's counted in
+// poolHeapAllocations.
+
+
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include "seq.h"
+#include "pool.h"
+
+#include <stdint.h>
+
+
+#define HANDLE_INDEX_BITS     22 // up to 4M entities of one type
+#define HANDLE_MAX_INDEX      ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_MAX_GENERATION ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+
+
+template<class T> struct Handle {
+
+  uint32_t id;
+
+  Handle() { id = 0; }
+  Handle( uint32_t index, uint32_t generation ) { id = (generation << HANDLE_INDEX_BITS) | index; }
+
+  uint32_t index() const      { return id & HANDLE_MAX_INDEX; }
+  uint32_t generation() const { return id >> HANDLE_INDEX_BITS; }
+
+  bool isNull() const { return id == 0; }
+
+  bool operator == ( const Handle<T> &h ) const { return id == h.id; }
+  bool operator != ( const Handle<T> &h ) const { return id != h.id; }
+};
+
+
+template<class T> class SlotMap {
+
+  struct Slot {
+    uint32_t generation;
+    int      next;              // dense index if in use; otherwise the next free slot (or -1)
+  };
+
+  seq<T>        dense;
+  seq<uint32_t> denseSlot;      // the slot of each dense element
+  seq<Slot>     slots;
+  int           freeSlot;       // head of the free list (or -1)
+
+  void freeSlotOf( int i );
+
+ public:
+
+  SlotMap() { freeSlot = -1; }
+
+  // The dense array
+
+  int size() const { return dense.size(); }
+
+  T & operator [] ( int i ) const { return dense[i]; }
+
+  Handle<T> handle( int i ) const {
+    uint32_t s = denseSlot[i];
+    return Handle<T>( s, slots[s].generation );
+  }
+
+  // By handle.  get() returns NULL for a null or stale handle.
+
+  T *get( Handle<T> h ) const {
+    uint32_t s = h.index();
+    if (s >= (uint32_t) slots.size() || slots[s].generation != h.generation() || h.isNull())
+      return NULL;
+    return &dense[ slots[s].next ];
+  }
+
+  bool contains( Handle<T> h ) const { return get( h ) != NULL; }
+
+  Handle<T> add( const T &x );
+  bool remove( Handle<T> h );   // returns false if 'h' is stale
+  void removeAt( int i );       // remove dense element i
+  void clear();                 // remove all (every outstanding handle becomes stale)
+  void reserve( int n );        // make room for 'n' entities
+};
+
+
+template<class T>
+Handle<T> SlotMap<T>::add( const T &x )
+
+{
+  int s;
+
+  poolHeapAllocations += (dense.size() == dense.capacity()) + (denseSlot.size() == denseSlot.capacity());
+
+  if (freeSlot >= 0) {
+    s = freeSlot;
+    freeSlot = slots[s].next;
+  }
+  else {
+    if ((uint32_t) slots.size() > HANDLE_MAX_INDEX) {
+      cerr << "SlotMap: More than " << HANDLE_MAX_INDEX+1 << " entities of one type" << endl;
+      exit(-1);
+    }
+    Slot slot;
+    slot.generation = 1;
+    poolHeapAllocations += (slots.size() == slots.capacity());
+    slots.add( slot );
+    s = slots.size()-1;
+  }
+
+  slots[s].next = dense.size();
+
+  dense.add( x );
+  denseSlot.add( s );
+
+  return Handle<T>( s, slots[s].generation );
+}
+
+
+// Bump the generation of the slot of dense element i and put it on
+// the free list
+
+template<class T>
+void SlotMap<T>::freeSlotOf( int i )
+
+{
+  Slot &slot = slots[ denseSlot[i] ];
+
+  slot.generation = (slot.generation == HANDLE_MAX_GENERATION ? 1 : slot.generation+1);
+  slot.next = freeSlot;
+  freeSlot = denseSlot[i];
+}
+
+
+template<class T>
+void SlotMap<T>::removeAt( int i )
+
+{
+  freeSlotOf( i );
+
+  // Move the last element into the hole
+
+  int last = dense.size()-1;
+
+  if (i != last) {
+    dense[i] = dense[last];
+    denseSlot[i] = denseSlot[last];
+    slots[ denseSlot[i] ].next = i;
+  }
+
+  dense.remove();
+  denseSlot.remove();
+}
+
+
+template<class T>
+bool SlotMap<T>::remove( Handle<T> h )
+
+{
+  if (!contains( h ))
+    return false;
+
+  removeAt( slots[ h.index() ].next );
+  return true;
+}
+
+
+template<class T>
+void SlotMap<T>::clear()
+
+{
+  for (int i=0; i<dense.size(); i++)
+    freeSlotOf( i );
+
+  dense.clear();
+  denseSlot.clear();
+}
+
+
+template<class T>
+void SlotMap<T>::reserve( int n )
+
+{
+  if (n > dense.capacity()) {
+    dense.reserve( n );
+    denseSlot.reserve( n );
+    poolHeapAllocations += 2;
+  }
+
+  if (n > slots.capacity()) {
+    slots.reserve( n );
+    poolHeapAllocations++;
+  }
+}
+
+#endif
@@ -0,0 +1,81 @@
+// snapshot.h
+//
+// An immutable copy of everything the renderer needs to draw one
+// frame.  The simulation thread fills one of these after each tick
+// and hands it to the render thread through a TripleBuffer, so the
+// renderer never reads the live World.
+//
+// A snapshot keeps its storage from one tick to the next.  reserve()
+// makes room in it for as many entities as the world config allows,
+// so that filling it doesn't go to the heap during play.
+
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "headers.h"
+#include "seq.h"
+#include "worldconfig.h"
+
+
+struct SegmentState {
+  vec2  pos;
+  vec2  dir;
+  bool  isHead;
+  float phase;                  // leg phase of this segment
+};
+
+
+struct MushroomState {
+  vec2 pos;
+  int  damage;
+};
+
+
+struct SpiderState {
+  vec2 pos;
+  vec2 vel;
+};
+
+
+class RenderSnapshot {
+
+ public:
+
+  seq<MushroomState> mushrooms;
+  seq<SegmentState>  segments;
+  seq<vec2>          darts;
+  seq<SpiderState>   spiders;
+
+  vec2 playerPos;
+
+  int  score;
+  int  level;
+  int  livesRemaining;
+
+  bool gameOver;
+  bool pauseForMessage;
+  bool playerDied;
+  bool goToNextLevel;
+
+  unsigned int tick;            // simulation tick at which this was taken
+
+  double lastMoveTime;          // arrival time of the last player move applied
+
+  RenderSnapshot() {
+    playerPos = vec2(0, 0);
+    score = level = livesRemaining = 0;
+    gameOver = pauseForMessage = playerDied = goToNextLevel = false;
+    tick = 0;
+    lastMoveTime = 0;
+  }
+
+  void reserve() {
+    mushrooms.reserve( worldConfig.numRows * worldConfig.numCols() );
+    segments.reserve( worldConfig.maxCentipedeSegments );
+    darts.reserve( worldConfig.maxDartsAtOnce );
+    spiders.reserve( worldConfig.maxSpidersAtOnce );
+  }
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "spider.h"
 #include "main.h"
 #include "worldDefs.h"
+#include "vertexformat.h"
 
 #include <cmath>
 #include <cstdlib>
@@ -43,34 +44,13 @@ static void addCircleFan(seq<vec2> &pos, seq<vec3> &col, vec2 centre, float r, v
         col.add(c);
 }
 
-static void uploadInterleaved(GLuint VBO, const seq<vec2> &pos, const seq<vec3> &col)
-{
-    int n = pos.size();
-    float *buf = new float[n * 5];
-    float *p = buf;
-    for (int i = 0; i < n; i++)
-    {
-        *p++ = pos[i].x;
-        *p++ = pos[i].y;
-        *p++ = col[i].x;
-        *p++ = col[i].y;
-        *p++ = col[i].z;
-    }
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, n * 5 * sizeof(float), buf, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    delete[] buf;
-}
-
 Spider::Spider(vec2 startPos, vec2 startVel)
 {
     pos = startPos;
+    prevPos = startPos;
     vel = startVel;
     alive = true;
     changeTimer = 0.2f + 0.6f * rand01();
-
-    if (db == NULL)
-        generateVAOs();
 }
 
 float Spider::radius() const { return SPIDER_RADIUS; }
@@ -91,10 +71,7 @@ void Spider::generateVAOs()
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    setupPackedVertexAttribs(); // position and palette index
 
     glBindVertexArray(0);
 
@@ -160,6 +137,7 @@ void Spider::generateVAOs()
 void Spider::update(float elapsedTime)
 {
     // Move
+    prevPos = pos;
     pos = pos + elapsedTime * vel;
 
     // Occasionally change vertical behavior
@@ -170,9 +148,9 @@ void Spider::update(float elapsedTime)
         float r = rand01();
         float vy = 0.0f;
         if (r < 0.33f)
-            vy = +SPIDER_SPEED_Y;
+            vy = +worldConfig.spiderSpeedY;
         else if (r < 0.66f)
-            vy = -SPIDER_SPEED_Y;
+            vy = -worldConfig.spiderSpeedY;
         else
             vy = 0.0f;
 
@@ -195,7 +173,7 @@ void Spider::update(float elapsedTime)
     }
 }
 
-void Spider::draw(mat4 &worldToViewTransform)
+void Spider::draw(vec2 pos, vec2 vel, mat4 &worldToViewTransform)
 {
     mat4 T = translate(pos.x, pos.y, 0.0f);
     float angle = atan2(vel.y, vel.x); // face movement direction
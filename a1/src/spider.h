@@ -8,12 +8,14 @@ class Spider {
 
 public:
   vec2  pos;
+  vec2  prevPos; // at the start of the last update (for the continuous dart test)
   vec2  vel;
   bool  alive;
 
   // timer for changing movement pattern
   float changeTimer;
 
+  Spider() {}
   Spider(vec2 startPos, vec2 startVel);
 
   static void generateVAOs();
@@ -21,8 +23,8 @@ public:
   // Update position and behavior
   void update(float elapsedTime);
 
-  // Draw at pos
-  void draw(mat4 &worldToViewTransform);
+  // Draw at pos, facing along vel
+  static void draw(vec2 pos, vec2 vel, mat4 &worldToViewTransform);
 
   // Collision radius
   float radius() const;
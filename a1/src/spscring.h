@@ -0,0 +1,47 @@
+// spscring.h
+//
+// A lock-free ring buffer with exactly one producer thread and one
+// consumer thread.  N must be a power of two.
+
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+
+
+template<class T, int N> class SPSCRing {
+
+  T items[N];
+
+  std::atomic<unsigned int> head;  // next slot to read; written by the consumer
+  std::atomic<unsigned int> tail;  // next slot to write; written by the producer
+
+public:
+
+  SPSCRing() : head(0), tail(0) {}
+
+  // Producer side.  Returns false (and drops x) if the ring is full.
+
+  bool push( const T &x ) {
+    unsigned int t = tail.load( std::memory_order_relaxed );
+    if (t - head.load( std::memory_order_acquire ) == N)
+      return false;
+    items[ t & (N-1) ] = x;
+    tail.store( t+1, std::memory_order_release );
+    return true;
+  }
+
+  // Consumer side.  Returns false if the ring is empty.
+
+  bool pop( T &x ) {
+    unsigned int h = head.load( std::memory_order_relaxed );
+    if (h == tail.load( std::memory_order_acquire ))
+      return false;
+    x = items[ h & (N-1) ];
+    head.store( h+1, std::memory_order_release );
+    return true;
+  }
+};
+
+#endif
@@ -16,6 +16,7 @@
 #include "strokefont.h"
 #include "fg_stroke.h" 
 #include "gpuProgram.h" 
+#include "arena.h"
 
 
 // Shaders for font rendering
@@ -70,9 +71,34 @@ void setupStrokeStrings()
 
 
 
-void drawStrokeString( string str, float x, float y, float height )
+// The most vertices in any strip of the font
+
+static int maxStripLength()
 
 {
+  static int maxLength = 0;
+
+  if (maxLength == 0) {
+    SFG_StrokeFont *font = &fgStrokeMonoRoman;
+    for (int c=0; c<font->Quantity; c++)
+      for (int i=0; i<font->Characters[c]->Number; i++)
+	if (font->Characters[c]->Strips[i].Number > maxLength)
+	  maxLength = font->Characters[c]->Strips[i].Number;
+  }
+
+  return maxLength;
+}
+
+
+
+void drawStrokeString( const char *str, float x, float y, float height )
+
+{
+  // Space for the vertices of one stroke at a time (in the frame's
+  // arena)
+
+  float *verts = frameArena.alloc<float>( maxStripLength()*2 );
+
   float s = height / (float) fgStrokeMonoRoman.Height; // scale of letters
   float xPos = x;
 
@@ -80,7 +106,7 @@ void drawStrokeString( string str, float x, float y, float height )
 
   // Draw each letter
 
-  for (unsigned int k=0; k<str.size(); k++) 
+  for (int k=0; str[k] != '\0'; k++) 
 
     if (str[k] == '\n') {	// handle newline
 
@@ -113,8 +139,6 @@ void drawStrokeString( string str, float x, float y, float height )
 
 	// Fill a buffer with the stroke's vertices
 
-	float *verts = new float[strip->Number*2];
-
 	for (int j=0; j<strip->Number; j++) {
 	  verts[j*2+0] = strip->Vertices[ j ].X;
 	  verts[j*2+1] = strip->Vertices[ j ].Y;
@@ -127,8 +151,6 @@ void drawStrokeString( string str, float x, float y, float height )
 	glBindBuffer( GL_ARRAY_BUFFER, VBO );
 	glBufferData( GL_ARRAY_BUFFER, strip->Number*2*sizeof(float), verts, GL_STATIC_DRAW );
 
-	delete[] verts;
-
 	// Draw the stroke
 
 	glEnableVertexAttribArray( 0 );
@@ -11,7 +11,7 @@
 
 void setupStrokeStrings();
 
-void drawStrokeString( string str, float x, float y, float height );
+void drawStrokeString( const char *str, float x, float y, float height );
 
 extern GPUProgram *fontGPUProg;
 
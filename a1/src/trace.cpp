@@ -0,0 +1,158 @@
+// trace.cpp
+
+
+#include "trace.h"
+
+
+bool TraceWriter::open( const char *filename )
+
+{
+  file = fopen( filename, "w" );
+
+  if (!file) {
+    cerr << "TraceWriter: Could not open " << filename << " for writing" << endl;
+    return false;
+  }
+
+  fputs( "[\n", file );
+
+  current = new string();
+  current->reserve( TRACE_BUFFER_SIZE );
+  firstEvent = true;
+  closing = false;
+
+  writer = thread( &TraceWriter::writeLoop, this );
+
+  return true;
+}
+
+
+// Flush everything and wait for the writer thread to finish
+
+void TraceWriter::close()
+
+{
+  if (!file)
+    return;
+
+  handOff();
+
+  {
+    unique_lock<mutex> l( lock );
+    closing = true;
+  }
+  wakeWriter.notify_one();
+
+  writer.join();
+
+  fputs( "\n]\n", file );
+  fclose( file );
+  file = NULL;
+}
+
+
+// The writer thread: write full buffers as they arrive
+
+void TraceWriter::writeLoop()
+
+{
+  while (true) {
+
+    seq<string *> toWrite;
+    bool done;
+
+    {
+      unique_lock<mutex> l( lock );
+
+      while (pending.size() == 0 && !closing)
+        wakeWriter.wait( l );
+
+      for (int i=0; i<pending.size(); i++)
+        toWrite.add( pending[i] );
+      pending.clear();
+
+      done = closing;
+    }
+
+    for (int i=0; i<toWrite.size(); i++) {
+      fwrite( toWrite[i]->data(), 1, toWrite[i]->size(), file );
+      delete toWrite[i];
+    }
+
+    if (done)
+      return;
+  }
+}
+
+
+// Pass the current buffer to the writer thread and start a new one
+
+void TraceWriter::handOff()
+
+{
+  {
+    unique_lock<mutex> l( lock );
+    pending.add( current );
+  }
+  wakeWriter.notify_one();
+
+  current = new string();
+  current->reserve( TRACE_BUFFER_SIZE );
+}
+
+
+void TraceWriter::append( const char *event )
+
+{
+  if (!firstEvent)
+    current->append( ",\n" );
+
+  current->append( event );
+  firstEvent = false;
+
+  if (current->size() >= TRACE_BUFFER_SIZE)
+    handOff();
+}
+
+
+// A complete ("X") event
+
+void TraceWriter::span( const char *name, const char *category, int thread, unsigned long long start, unsigned long long duration,
+                        unsigned long long allocs, unsigned long long allocBytes )
+
+{
+  if (!file)
+    return;
+
+  char event[256];
+
+  if (allocs == 0)
+    snprintf( event, sizeof(event),
+              "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              name, category, thread, start / 1000.0, duration / 1000.0 );
+  else
+    snprintf( event, sizeof(event),
+              "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+              "\"args\":{\"allocs\":%llu,\"bytes\":%llu}}",
+              name, category, thread, start / 1000.0, duration / 1000.0, allocs, allocBytes );
+
+  append( event );
+}
+
+
+// A metadata event that labels a thread's lane
+
+void TraceWriter::threadName( int thread, const char *name )
+
+{
+  if (!file)
+    return;
+
+  char event[256];
+
+  snprintf( event, sizeof(event),
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            thread, name );
+
+  append( event );
+}
@@ -0,0 +1,59 @@
+// trace.h
+//
+// Writes a Chrome trace-event file (JSON array format), which can be
+// loaded into chrome://tracing or https://ui.perfetto.dev.
+//
+// Events are formatted into a memory buffer.  Full buffers are handed
+// to a writer thread, so the thread producing events never waits on
+// the file.
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "headers.h"
+#include "seq.h"
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define TRACE_BUFFER_SIZE (256 * 1024) // bytes of events per buffer handed to the writer thread
+
+
+class TraceWriter {
+
+  FILE *file;
+
+  string *current;              // buffer being filled
+  bool    firstEvent;
+
+  seq<string *> pending;        // full buffers waiting to be written
+  bool          closing;
+  mutex              lock;
+  condition_variable wakeWriter;
+  thread             writer;
+
+  void writeLoop();
+  void handOff();
+  void append( const char *event );
+
+ public:
+
+  TraceWriter() { file = NULL; current = NULL; }
+
+  bool open( const char *filename );
+  void close();
+
+  bool isOpen() { return file != NULL; }
+
+  // Timestamps and durations are in nanoseconds.  A span with heap
+  // allocations has their number and size as its arguments.
+
+  void span( const char *name, const char *category, int thread, unsigned long long start, unsigned long long duration,
+             unsigned long long allocs = 0, unsigned long long allocBytes = 0 );
+  void threadName( int thread, const char *name );
+};
+
+#endif
@@ -0,0 +1,63 @@
+// triplebuffer.h
+//
+// A lock-free triple buffer for passing a value from one producer
+// thread to one consumer thread.
+//
+// The producer fills writeBuffer() and calls publish().  The consumer
+// calls fetch() to pick up the most recently published buffer (if
+// there is a new one) and then reads readBuffer().  Neither side ever
+// waits for the other: the producer always has a free buffer to write
+// into, and the consumer always has a complete buffer to read from.
+// Intermediate buffers are dropped if the producer is faster.
+
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+
+template<class T> class TripleBuffer {
+
+  static const int INDEX_MASK = 3;
+  static const int FRESH      = 4; // set in 'middle' when it holds an unread buffer
+
+  T buffers[3];
+
+  std::atomic<int> middle;     // buffer in transit between the threads
+  int back;                    // owned by the producer
+  int front;                   // owned by the consumer
+
+public:
+
+  TripleBuffer() : middle(1) {
+    back  = 0;
+    front = 2;
+  }
+
+  // Producer side
+
+  T & writeBuffer() { return buffers[ back ]; }
+
+  void publish() {
+    back = middle.exchange( back | FRESH, std::memory_order_acq_rel ) & INDEX_MASK;
+  }
+
+  // Consumer side.  Returns true if a new buffer was picked up.
+
+  bool fetch() {
+    if (!(middle.load( std::memory_order_relaxed ) & FRESH))
+      return false;
+
+    front = middle.exchange( front, std::memory_order_acq_rel ) & INDEX_MASK;
+    return true;
+  }
+
+  T & readBuffer() { return buffers[ front ]; }
+
+  // All three buffers, for setting them up before either side starts
+
+  T & buffer( int i ) { return buffers[ i ]; }
+};
+
+#endif
@@ -0,0 +1,160 @@
+// uniformgrid.cpp
+
+
+#include "uniformgrid.h"
+#include "worldDefs.h"
+
+
+void UniformGrid::clear()
+
+{
+  // The field, plus four columns at either side (see
+  // World::updateSpider) and a row above the top row
+
+  float newColSpacing = worldConfig.colSpacing;
+  float newRowSpacing = worldConfig.rowSpacing;
+
+  float newLeft = WORLD_LEFT_EDGE - 4 * newColSpacing;
+  float newBottom = -1;
+
+  int newCols = ceil( (WORLD_RIGHT_EDGE + 4 * newColSpacing - newLeft) / newColSpacing );
+  int newRows = ceil( (WORLD_TOP_ROW + newRowSpacing - newBottom) / newRowSpacing );
+
+  if (newCols != cols || newRows != rows) {
+    delete [] cells;
+    cells = new Cell[ newRows * newCols ];
+    cols = newCols;
+    rows = newRows;
+    reserveCells();
+  }
+  else
+    for (int i=0; i<rows*cols; i++) {
+      cells[i].x.clear();
+      cells[i].y.clear();
+      cells[i].id.clear();
+    }
+
+  left = newLeft;
+  bottom = newBottom;
+  colSpacing = newColSpacing;
+  rowSpacing = newRowSpacing;
+
+  cellOf.clear();
+  slotOf.clear();
+}
+
+
+void UniformGrid::reserve( int n )
+
+{
+  if (n <= reserved)
+    return;
+
+  reserved = n;
+
+  cellOf.reserve( n );
+  slotOf.reserve( n );
+
+  reserveCells();
+}
+
+
+void UniformGrid::reserveCells()
+
+{
+  int n = (reserved < GRID_CELL_RESERVE ? reserved : GRID_CELL_RESERVE);
+
+  for (int i=0; i<rows*cols; i++) {
+    cells[i].x.reserve( n );
+    cells[i].y.reserve( n );
+    cells[i].id.reserve( n );
+  }
+}
+
+
+void UniformGrid::move( int id, vec2 pos )
+
+{
+  while (cellOf.size() <= id) {
+    cellOf.add( -1 );
+    slotOf.add( -1 );
+  }
+
+  int c = row( pos.y ) * cols + col( pos.x );
+
+  if (cellOf[id] == c) {        // still in the same cell
+    int s = slotOf[id];
+    cells[c].x.array()[s] = pos.x;
+    cells[c].y.array()[s] = pos.y;
+    return;
+  }
+
+  if (cellOf[id] >= 0)
+    removeFromCell( id );
+
+  Cell &cell = cells[c];
+
+  cellOf[id] = c;
+  slotOf[id] = cell.size();
+
+  cell.x.add( pos.x );
+  cell.y.add( pos.y );
+  cell.id.add( id );
+}
+
+
+void UniformGrid::remove( int id )
+
+{
+  if (id >= cellOf.size() || cellOf[id] < 0)
+    return;
+
+  removeFromCell( id );
+}
+
+
+void UniformGrid::renumber( int from, int to )
+
+{
+  while (cellOf.size() <= to) {
+    cellOf.add( -1 );
+    slotOf.add( -1 );
+  }
+
+  if (from >= cellOf.size() || cellOf[from] < 0)
+    return;
+
+  cellOf[to] = cellOf[from];
+  slotOf[to] = slotOf[from];
+  cellOf[from] = -1;
+
+  cells[ cellOf[to] ].id[ slotOf[to] ] = to;
+}
+
+
+// Take 'id' out of its cell, moving the cell's last entity into its
+// slot.  (So the order of a cell's entities changes as they come and
+// go: queries that have to choose between equally good entities go by
+// their ids, not by the order they are found in.)
+
+void UniformGrid::removeFromCell( int id )
+
+{
+  Cell &cell = cells[ cellOf[id] ];
+
+  int s = slotOf[id];
+  int last = cell.size()-1;
+
+  if (s != last) {
+    cell.x[s] = cell.x[last];
+    cell.y[s] = cell.y[last];
+    cell.id[s] = cell.id[last];
+    slotOf[ cell.id[s] ] = s;
+  }
+
+  cell.x.remove();
+  cell.y.remove();
+  cell.id.remove();
+
+  cellOf[id] = -1;
+}
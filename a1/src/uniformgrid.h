@@ -0,0 +1,96 @@
+// uniformgrid.h
+//
+// A uniform grid over the playing field, for finding the centipede
+// segments and spiders near a point without testing all of them.
+// (Mushrooms don't move, and have a grid of their own: see
+// mushroomgrid.h.)
+//
+// The cells are worldConfig.colSpacing wide and worldConfig.rowSpacing
+// high, lined up with the mushroom grid.  The grid covers the field
+// and the margins at either side where spiders come and go.  Each
+// cell keeps the positions and ids of the entities in it packed in
+// arrays, so that a cell's entities can be tested with the segment
+// sweep kernel (segmentsweep.h).  An entity's id is its index in
+// whatever holds it: the SegmentStore, or the SlotMap of spiders.
+//
+// The grid is kept up to date incrementally.  move() updates an
+// entity's position in place, and only moves the entity to another
+// cell when it has crossed into one, which at the usual speeds is a
+// few times a second.  A position outside the grid goes in the
+// nearest cell on its border, and the rows and columns of a query are
+// clamped in the same way, so a query always finds the entities
+// inside the area it covers.
+//
+// Storage is kept from level to level.  reserve() makes room for the
+// ids of 'n' entities, and for up to GRID_CELL_RESERVE of them in each
+// cell, so that moving them doesn't go to the heap unless more than
+// that crowd into one cell (and then only the first time).
+
+
+#ifndef UNIFORMGRID_H
+#define UNIFORMGRID_H
+
+#include "headers.h"
+#include "seq.h"
+
+#define GRID_CELL_RESERVE 8     // entities that each cell has room for, at most, after reserve()
+
+
+class UniformGrid {
+
+ public:
+
+  struct Cell {
+    seq<float> x, y;
+    seq<int>   id;
+
+    int size() const { return id.size(); }
+  };
+
+ private:
+
+  Cell *cells;
+  int rows, cols;
+  float left, bottom;           // lower-left corner of cell (0,0)
+  float colSpacing, rowSpacing;
+  int reserved;                 // entities that reserve() made room for
+
+  seq<int> cellOf;              // by id: the cell it's in, or -1 if it's not in the grid
+  seq<int> slotOf;              //        and its index in that cell's arrays
+
+  void removeFromCell( int id );
+  void reserveCells();
+
+ public:
+
+  UniformGrid() {
+    cells = NULL;
+    rows = cols = 0;
+    reserved = 0;
+  }
+
+  ~UniformGrid() { delete [] cells; }
+
+  void clear();                 // remove everything, and fit the grid to the world config
+  void reserve( int n );        // make room for 'n' entities
+  void move( int id, vec2 pos ); // set the position of 'id', adding it if it isn't in the grid
+  void remove( int id );
+  void renumber( int from, int to ); // entity 'from' is now 'to' (which isn't in the grid)
+
+  // The column and row of the cell containing x or y, clamped to the
+  // grid
+
+  int col( float x ) const {
+    float c = floor( (x - left) / colSpacing );
+    return (c < 0 ? 0 : (c > cols-1 ? cols-1 : (int) c));
+  }
+
+  int row( float y ) const {
+    float r = floor( (y - bottom) / rowSpacing );
+    return (r < 0 ? 0 : (r > rows-1 ? rows-1 : (int) r));
+  }
+
+  Cell & cell( int r, int c ) { return cells[ r*cols + c ]; }
+};
+
+#endif
@@ -0,0 +1,93 @@
+// vertexformat.cpp
+
+
+#include "vertexformat.h"
+
+
+// The palette
+
+static vec3 palette[ MAX_PALETTE_COLOURS ];
+static int  numPaletteColours = 0;
+
+
+int paletteIndex( vec3 colour )
+
+{
+  for (int i=0; i<numPaletteColours; i++)
+    if (palette[i].x == colour.x && palette[i].y == colour.y && palette[i].z == colour.z)
+      return i;
+
+  if (numPaletteColours == MAX_PALETTE_COLOURS) {
+    cerr << "paletteIndex: More than " << MAX_PALETTE_COLOURS << " colours are in use" << endl;
+    exit(1);
+  }
+
+  palette[ numPaletteColours ] = colour;
+  return numPaletteColours++;
+}
+
+
+void setPaletteColour( int i, vec3 colour )
+
+{
+  if (i < 0 || i >= numPaletteColours) {
+    cerr << "setPaletteColour: No palette entry " << i << endl;
+    return;
+  }
+
+  palette[i] = colour;
+}
+
+
+void uploadPalette( GPUProgram *prog )
+
+{
+  if (numPaletteColours > 0)
+    prog->setVec3( "palette", palette, numPaletteColours );
+}
+
+
+void setupPackedVertexAttribs()
+
+{
+  glVertexAttribPointer( 0, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), 0 ); // two normalized shorts for a position
+  glEnableVertexAttribArray( 0 );
+
+  glVertexAttribIPointer( 1, 1, GL_UNSIGNED_BYTE, sizeof(PackedVertex), (void*) (2*sizeof(GLshort)) ); // one byte for a palette index
+  glEnableVertexAttribArray( 1 );
+}
+
+
+// Convert a coordinate in [-1,1] to a normalized short
+
+static GLshort packCoord( float v )
+
+{
+  if (v > 1)
+    v = 1;
+  else if (v < -1)
+    v = -1;
+
+  return (GLshort) rint( v * 32767.0f );
+}
+
+
+void uploadInterleaved( GLuint VBO, const seq<vec2> &positions, const seq<vec3> &colours )
+
+{
+  int n = positions.size();
+  PackedVertex *buffer = new PackedVertex[n];
+
+  for (int i=0; i<n; i++) {
+    buffer[i].x = packCoord( positions[i].x );
+    buffer[i].y = packCoord( positions[i].y );
+    buffer[i].colourIndex = paletteIndex( colours[i] );
+    buffer[i].pad[0] = buffer[i].pad[1] = buffer[i].pad[2] = 0;
+  }
+
+  glBindBuffer( GL_ARRAY_BUFFER, VBO );
+  glBufferData( GL_ARRAY_BUFFER, n*sizeof(PackedVertex), buffer, GL_STATIC_DRAW );
+  glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+  delete[] buffer;
+}
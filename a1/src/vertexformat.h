@@ -0,0 +1,49 @@
+// vertexformat.h
+//
+// Packed vertex format shared by all world objects.
+//
+// Each vertex is stored as two 16-bit normalized positions plus a
+// one-byte index into a colour palette, padded to 8 bytes (down from
+// the five floats = 20 bytes used previously).  Model geometry is
+// centred at (0,0) and is always much smaller than [-1,1], so a
+// normalized short gives far better than sub-pixel precision.
+//
+// The palette is a uniform array in the main shader.  Colours are
+// added to it as geometry is built, and it is uploaded once per
+// frame, so a palette entry can be changed (e.g. per level) without
+// touching any VBO.
+
+
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include "headers.h"
+#include "seq.h"
+#include "gpuProgram.h"
+
+#define MAX_PALETTE_COLOURS 32  // must match the size of 'palette' in the main vertex shader
+
+
+struct PackedVertex {
+  GLshort x, y;        // normalized position in [-1,1]
+  GLubyte colourIndex; // index into the palette
+  GLubyte pad[3];      // keep each vertex 4-byte aligned
+};
+
+
+// Set up attribute 0 (position) and attribute 1 (colour index) for
+// the currently bound VAO and VBO.
+
+void setupPackedVertexAttribs();
+
+// Pack 'positions' and 'colours' and copy them into 'VBO'
+
+void uploadInterleaved( GLuint VBO, const seq<vec2> &positions, const seq<vec3> &colours );
+
+// Palette access
+
+int  paletteIndex( vec3 colour );       // find (or add) a colour in the palette
+void setPaletteColour( int i, vec3 colour );
+void uploadPalette( GPUProgram *prog ); // copy the palette to the 'palette' uniform of 'prog'
+
+#endif
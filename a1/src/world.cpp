@@ -1,51 +1,54 @@
 // world.cpp
 
 #include "world.h"
-#include "gpuProgram.h"
 #include "main.h"
-#include "strokefont.h"
+#include "profiler.h"
 
-#include <sstream>
-#include <iomanip>
+#include "segmentsweep.h"
+#include "jobs.h"
 
-extern Mushroom *closestMush;
-
-#define TEXT_SIZE 0.06 // as a fraction of centre-to-top distance
+#include <algorithm>
 
 // Initialize the world state.  This is called before each new level.
 
-void World::initWorld(GLFWwindow *w)
+void World::initWorld()
 
 {
-  window = w;
   score = 0;
   level = 0;
   gameOver = false;
+  tick = 0;
+  playerInvulnerable = false;
 
+  delete player;
   player = new Player(vec2(0, 0));
-  livesRemaining = INIT_LIVES_REMAINING;
+  livesRemaining = worldConfig.initLivesRemaining;
 
-  highlightMushroom = NULL;
+  highlightMushroom = MushroomHandle();
+  reserveEntities();
   // SPIDER CODE.
-  spider = NULL;
-  spiderSpawnTimer = 3.0f; // spawn after a few seconds
+  spiders.clear();
+  spiderGrid.clear();
+  segmentStep = 0;
+  spiderStep = 0;
+  spiderSpawnTimer = worldConfig.spiderFirstSpawn; // spawn after a few seconds
 
   // Random mushrooms
 
   srand(1574);
 
-  numCols = (WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE) / COL_SPACING - 1;
+  numCols = worldConfig.numCols();
 
-  mushrooms.clear();
+  clearMushrooms();
 
-  for (int i = 0; i < INIT_NUM_MUSHROOMS; i++)
+  for (int i = 0; i < worldConfig.initNumMushrooms; i++)
   {
 
     // Generate random row/col
 
-    int r = floor(randIn01() * NUM_ROWS);
-    if (r == NUM_ROWS)
-      r = NUM_ROWS - 1;
+    int r = floor(randIn01() * worldConfig.numRows);
+    if (r == worldConfig.numRows)
+      r = worldConfig.numRows - 1;
 
     int c = floor(randIn01() * numCols);
     if (c == numCols)
@@ -53,20 +56,15 @@ void World::initWorld(GLFWwindow *w)
 
     // Convert to world coordinates
 
-    vec2 worldPos(WORLD_LEFT_EDGE + (c + 1) * COL_SPACING, WORLD_TOP_ROW - r * ROW_SPACING);
+    vec2 worldPos(WORLD_LEFT_EDGE + (c + 1) * worldConfig.colSpacing, WORLD_TOP_ROW - r * worldConfig.rowSpacing);
 
-    // Check that it doesn't already exist
+    // Check that it doesn't already exist (on the mushroom grid, as
+    // worldPos is a grid point)
 
-    bool exists = false;
-    for (int j = 0; j < mushrooms.size(); j++)
-      if (mushrooms[j]->pos == worldPos)
-      {
-        exists = true;
-        break;
-      }
+    bool exists = (useStandardGrid ? standardGrid.occupied(r, c) : runtimeGrid.occupied(r, c));
 
     if (!exists)
-      mushrooms.add(new Mushroom(worldPos));
+      addMushroom(worldPos);
   }
 
   // Init the rest of the level
@@ -74,482 +72,1070 @@ void World::initWorld(GLFWwindow *w)
   initLevel();
 }
 
+// Make room in the entity pools for as many entities as the world
+// config allows, so that play doesn't have to go to the heap: a
+// mushroom at every grid position, the most darts and spiders at once,
+// and, since a split centipede has no more segments than it had
+// before, a centipede for every segment of the first level's.  The
+// grids and the scratch sequences get room for the same entities
+// (with every mushroom possibly off the mushroom grid).
+
+void World::reserveEntities()
+
+{
+  int maxSegs = worldConfig.maxCentipedeSegments;
+
+  mushrooms.reserve(worldConfig.numRows * worldConfig.numCols());
+  standardGrid.reserve(worldConfig.numRows * worldConfig.numCols());
+  runtimeGrid.reserve(worldConfig.numRows * worldConfig.numCols());
+  darts.reserve(worldConfig.maxDartsAtOnce);
+  spiders.reserve(worldConfig.maxSpidersAtOnce);
+  centipedes.reserve(maxSegs);
+  dartHits.reserve(worldConfig.maxDartsAtOnce);
+  newMushrooms.reserve(worldConfig.maxDartsAtOnce);
+  compactOrder.reserve(maxSegs);
+
+  for (int n = 1; n <= maxSegs; n++)
+    Centipede::reservePaths(n, maxSegs / n);
+
+  segmentGrid.reserve(maxSegs);
+  spiderGrid.reserve(worldConfig.maxSpidersAtOnce);
+}
+
+// Add a mushroom, and index it in the mushroom grid
+
+MushroomHandle World::addMushroom(vec2 pos)
+
+{
+  MushroomHandle h = mushrooms.add(Mushroom(pos));
+
+  if (useStandardGrid)
+    standardGrid.add(h);
+  else
+    runtimeGrid.add(h);
+
+  return h;
+}
+
+void World::removeMushroom(MushroomHandle h)
+
+{
+  if (useStandardGrid)
+    standardGrid.remove(h);
+  else
+    runtimeGrid.remove(h);
+
+  mushrooms.remove(h);
+}
+
+// Remove all mushrooms, and choose the grid for the current world
+// config
+
+void World::clearMushrooms()
+
+{
+  mushrooms.clear();
+
+  useStandardGrid = StandardGrid::matchesConfig();
+
+  if (useStandardGrid)
+    standardGrid.clear();
+  else
+    runtimeGrid.clear();
+}
+
+// Remove all centipedes, mushrooms, darts and spiders, so that a
+// benchmark can build its own scenario.
+
+void World::clearEntities()
+
+{
+  clearCentipedes();
+  segments.clear();
+  segmentGrid.clear();
+  clearMushrooms();
+  darts.clear();
+  spiders.clear();
+  spiderGrid.clear();
+}
+
+void World::addCentipede(int numSegs, vec2 headPos, vec2 dir)
+
+{
+  Centipede cent(segments, numSegs, headPos, dir);
+  cent.random.seed(rand());
+  centipedes.add(cent);
+
+  for (int k = cent.first; k < cent.first + cent.numSegs; k++)
+    segmentGrid.move(k, segments.pos(k));
+}
+
+// Remove centipede i, giving its path back to the pool
+
+void World::removeCentipede(int i)
+
+{
+  centipedes[i].release();
+  centipedes.removeAt(i);
+}
+
+void World::clearCentipedes()
+
+{
+  for (int i = 0; i < centipedes.size(); i++)
+    centipedes[i].release();
+
+  centipedes.clear();
+}
+
+void World::addSpider(vec2 pos, vec2 vel)
+
+{
+  spiders.add(Spider(pos, vel));
+  spiderGrid.move(spiders.size() - 1, pos);
+}
+
+// Total number of segments in all centipedes
+
+int World::numSegments()
+
+{
+  int n = 0;
+
+  for (int i = 0; i < centipedes.size(); i++)
+    n += centipedes[i].numSegs;
+
+  return n;
+}
+
 // Update the state of the world after 'elapsedTime' seconds have passed
 
 void World::updateState(float elapsedTime)
 {
+  PROFILE_SCOPE("updateState");
+
+  tick++;
+
   // Don't do anything if we're pausing while a message is being displayed
 
-  if (pauseForMessage || gameOver)
+  if (gameOver)
     return;
 
-  // Move centipedes.
+  if (pauseForMessage)
+  {
+    pauseTimeRemaining -= elapsedTime;
+
+    if (pauseTimeRemaining <= 0)
+      initLevel(); // pause is over, so start a new level
 
-  for (int i = 0; i < centipedes.size(); i++)
-    centipedes[i]->updatePose(elapsedTime);
+    return;
+  }
 
-  // Spawn spider occasionally (only one at a time)
-  spiderSpawnTimer -= elapsedTime;
-  if (!spider && spiderSpawnTimer <= 0.0f)
+  // Move the centipedes, spiders and darts, checking for darts
+  // hitting something and for the player being caught.
+  //
+  // At the original speed, this is done in one step.  When the game
+  // is sped up, things move far enough in a tick for darts to pass
+  // through them, so the tick is split into substeps and the darts
+  // are tested continuously.
+
+  bool continuous = (speedMultiplier > 1);
+  int substeps = (continuous ? numSubsteps(elapsedTime) : 1);
+  float stepTime = elapsedTime / substeps;
+
+  for (int s = 0; s < substeps; s++)
   {
+    if (s > 0 && (playerDied || centipedes.size() == 0))
+      break;
 
-    // choose entry side
-    bool fromLeft = (rand() % 2) == 0;
+    // Move centipedes.
+
+    {
+      PROFILE_SCOPE("centipede move");
+
+      if (continuous)
+        segments.savePositions();
+
+      moveCentipedes(stepTime);
+    }
+
+    updateSegmentGrid(continuous);
+
+    // Move the spider and darts, checking for them hitting something.
+
+    updateSpider(stepTime);
+    updateDarts(stepTime, continuous);
 
-    float x = fromLeft ? (WORLD_LEFT_EDGE - 2 * COL_SPACING) : (WORLD_RIGHT_EDGE + 2 * COL_SPACING);
-    float y = -1.0f + 2.5f * ROW_SPACING + (rand() % 4) * 0.5f * ROW_SPACING; // in player-ish band
+    // See if a centipede's HEAD eats the player
 
-    float vx = fromLeft ? +SPIDER_SPEED_X : -SPIDER_SPEED_X;
-    float vy = (rand() % 3 - 1) * SPIDER_SPEED_Y; // -Y,0,+Y
+    {
+      PROFILE_SCOPE("head vs player");
 
-    spider = new Spider(vec2(x, y), vec2(vx, vy));
+      for (int i = 0; i < centipedes.size() && !playerInvulnerable; i++)
+        if ((segments.pos(centipedes[i].first) - player->pos).length() < 0.75 * worldConfig.rowSpacing)
+        {
+          playerDied = true;
+          pauseForMessage = true;
+          pauseTimeRemaining = worldConfig.pauseTimeForMessage;
 
-    // next spawn in ~[6..12] seconds after this one dies or leaves
-    spiderSpawnTimer = 6.0f + 6.0f * ((float)rand() / RAND_MAX);
+          break;
+        }
+    }
   }
 
-  if (spider)
+  // Remove a life if player was destroyed
+
+  if (playerDied)
   {
-    spider->update(elapsedTime * speedMultiplier);
 
-    // If it goes off to the left or right, remove it
-    if (spider->pos.x < WORLD_LEFT_EDGE - 4 * COL_SPACING ||
-        spider->pos.x > WORLD_RIGHT_EDGE + 4 * COL_SPACING)
+    livesRemaining--;
+
+    if (livesRemaining < 1)
     {
-      delete spider;
-      spider = NULL;
+      gameOver = true;
+      pauseForMessage = false;
     }
   }
+  else if (!gameOver && centipedes.size() == 0)
+  { // end of level
 
-  if (spider && (spider->pos - player->pos).length() < (spider->radius() + 0.35f * ROW_SPACING))
-  {
-    // same logic you use for centipede head killing player
-    chrono::system_clock::time_point t = chrono::system_clock::now();
-    t += chrono::duration<int>(PAUSE_TIME_FOR_MESSAGE);
+    // Add points for any remaining mushrooms.  Restore damaged mushrooms.
 
-    playerDied = true;
-    pauseForMessage = true;
-    pauseUntil = t;
+    for (int i = 0; i < mushrooms.size(); i++)
+      mushrooms[i].damage = 0;
 
-    // remove spider so it doesn't keep colliding during the pause
-    delete spider;
-    spider = NULL;
+    score += mushrooms.size() * SCORE_REMAINING_MUSHROOM;
+
+    // Start next level if game isn't yet over
+
+    if (level < worldConfig.maxLevel())
+      level++;
+
+    goToNextLevel = true;
+    pauseForMessage = true;
+    pauseTimeRemaining = worldConfig.pauseTimeForMessage;
   }
+}
 
-  // Move dart and check for it hitting something.
+// The number of substeps into which to split a sped-up tick of
+// 'elapsedTime', so that no centipede or spider moves further than a
+// segment's radius in one.  (Their paths are curved, and the
+// continuous dart test takes each substep's movement as a straight
+// line.)
 
-  for (int i = 0; i < darts.size(); i++)
-  {
+int World::numSubsteps(float elapsedTime)
 
-    // Move it
+{
+  double centipedeSpeed = worldConfig.centipedeInitSpeed + level * worldConfig.centipedeSpeedIncPerLevel;
+  double spiderSpeed = sqrt(worldConfig.spiderSpeedX * worldConfig.spiderSpeedX + worldConfig.spiderSpeedY * worldConfig.spiderSpeedY);
 
-    float distanceTravelled = DART_SPEED * elapsedTime * speedMultiplier;
+  double maxStep = (centipedeSpeed > spiderSpeed ? centipedeSpeed : spiderSpeed) * elapsedTime * speedMultiplier;
 
-    vec2 prevPos = darts[i]->pos; // Get old location of dart.
-    darts[i]->pos = darts[i]->pos + vec2(0, distanceTravelled);
+  int n = ceil(maxStep / SEG_BODY_RADIUS);
 
-    // Check for dart going off the top
+  if (n < 1)
+    return 1;
+  if (n > MAX_SUBSTEPS)
+    return MAX_SUBSTEPS;
+  return n;
+}
 
-    if (darts[i]->pos.y > WORLD_TOP_ROW)
-    {
-      darts.remove(i);
-      i--;
-      continue;
-    }
+// Move every centipede by 'elapsedTime'.
+//
+// A centipede's update only reads the mushrooms (which don't change
+// until the darts are updated) and writes its own span of the segment
+// store, and it has its own random numbers.  So when there are enough
+// segments to make it worthwhile, the centipedes are split among the
+// threads of the job pool.  The result is the same whichever thread updates
+// which centipede, and the same as updating them one by one.
 
-    // See if there's a mushroom along the dart's path
-    vec2 dir(0, 1);
-    Mushroom *closestMush = findClosestMushroomAhead(prevPos, dir, ROW_SPACING / 4);
+void World::moveCentipedes(float elapsedTime)
 
-    if (closestMush)
-    {
+{
+  int numSegs = segments.size() - segments.numHoles;
 
-      // See if this mushroom will be hit within the next time step
+  if (worldConfig.parallelSegments == 0 || numSegs < worldConfig.parallelSegments)
+  {
+    for (int i = 0; i < centipedes.size(); i++)
+      centipedes[i].updatePose(elapsedTime, segments);
+    return;
+  }
 
-      vec2 v = closestMush->pos - prevPos;
-      float distAlongLine = v.x * dir.x + v.y * dir.y;
-      float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x);
+  JobPool &jobs = jobPool();
 
-      if (distAlongLine > 0 && distAlongLine < distanceTravelled && distPerpToLine < ROW_SPACING / 4)
-      {
+  // Several chunks per thread, since centipedes differ in length
 
-        closestMush->damage += 1;
+  int chunk = centipedes.size() / (8 * jobs.numThreads()) + 1;
 
-        if (closestMush->damage >= MUSH_MAX_DAMAGE)
-        { // mushroom is destroyed
-          score += SCORE_DESTROY_MUSHROOM;
-          mushrooms.remove(mushrooms.findIndex(closestMush));
-        }
+  jobs.parallelFor("centipedes", centipedes.size(), chunk, [&](int begin, int end) {
+    for (int i = begin; i < end; i++)
+      centipedes[i].updatePose(elapsedTime, segments);
+  });
+}
 
-        darts.remove(i);
-        i--;
-        continue;
-      }
-    }
+// Bring the segment grid up to date after the centipedes have moved.
+// If 'continuous', also find how far the furthest segment moved.
 
-    if (spider)
-    {
-      // Use swept test this frame: from prevPos to prevPos + dir*distanceTravelled
-      vec2 dir(0, 1);
-      vec2 v = spider->pos - prevPos;
+void World::updateSegmentGrid(bool continuous)
 
-      float distAlongLine = v.x * dir.x + v.y * dir.y;
-      float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x);
+{
+  PROFILE_SCOPE("segment grid");
 
-      if (distAlongLine > 0 &&
-          distAlongLine < distanceTravelled &&
-          distPerpToLine < spider->radius())
-      {
-        score += SCORE_DESTROY_SPIDER;
+  float *posX = segments.posX.array();
+  float *posY = segments.posY.array();
+  float *prevX = segments.prevX.array();
+  float *prevY = segments.prevY.array();
 
-        delete spider;
-        spider = NULL;
+  float step = 0;
 
-        darts.remove(i);
-        i--;
-        continue;
-      }
+  for (int i = 0; i < centipedes.size(); i++)
+  {
+    Centipede &cent = centipedes[i];
+
+    for (int k = cent.first; k < cent.first + cent.numSegs; k++)
+    {
+      segmentGrid.move(k, vec2(posX[k], posY[k]));
+
+      if (continuous)
+        step = std::max(step, std::max(fabs(posX[k] - prevX[k]), fabs(posY[k] - prevY[k])));
     }
+  }
 
-    // See if a centipede segment is hit
+  segmentStep = step;
+}
 
-    float closestSegDist = MAXFLOAT;
-    Centipede *closestCent;
-    int closestSegIndex;
+// Spawn, move and remove spiders, and check whether one has reached
+// the player.
 
-    for (int j = 0; j < centipedes.size(); j++)
-    {
-      Centipede *cent = centipedes[j];
-      for (int k = 0; k < cent->segments.size(); k++)
-      {
+void World::updateSpider(float elapsedTime)
+{
+  PROFILE_SCOPE("spider");
 
-        Segment *seg = cent->segments[k]; // use this below
+  // Spawn spider occasionally (up to worldConfig.maxSpidersAtOnce at a time)
+  spiderSpawnTimer -= elapsedTime;
+  if (spiders.size() < worldConfig.maxSpidersAtOnce && spiderSpawnTimer <= 0.0f)
+  {
 
-        // Test segment/dart here
-        // moving in direction 'dir' (unit length).
-        vec2 start = prevPos;
-        vec2 dir(0, 1);
-        vec2 v = seg->pos - start;
+    // choose entry side
+    bool fromLeft = (rand() % 2) == 0;
 
-        float distAlongLine = v.x * dir.x + v.y * dir.y;        // [YOUR CODE HERE]
-        float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x); // [YOUR CODE HERE]
+    float x = fromLeft ? (WORLD_LEFT_EDGE - 2 * worldConfig.colSpacing) : (WORLD_RIGHT_EDGE + 2 * worldConfig.colSpacing);
+    float y = -1.0f + 2.5f * worldConfig.rowSpacing + (rand() % 4) * 0.5f * worldConfig.rowSpacing; // in player-ish band
 
-        if (distAlongLine > 0 && distPerpToLine < SEG_BODY_RADIUS && distAlongLine < closestSegDist)
-        {
-          closestSegDist = distAlongLine;
-          closestCent = cent;
-          closestSegIndex = k;
-        }
-      }
-    }
+    float vx = fromLeft ? +worldConfig.spiderSpeedX : -worldConfig.spiderSpeedX;
+    float vy = (rand() % 3 - 1) * worldConfig.spiderSpeedY; // -Y,0,+Y
+
+    spiders.add(Spider(vec2(x, y), vec2(vx, vy)));
+
+    // next spawn in ~[min..min+range] seconds after this one dies or leaves
+    spiderSpawnTimer = worldConfig.spiderSpawnMin + worldConfig.spiderSpawnRange * ((float)rand() / RAND_MAX);
+  }
+
+  spiderStep = 0;
+
+  for (int i = 0; i < spiders.size(); i++)
+  {
+    Spider &spider = spiders[i];
+
+    spider.update(elapsedTime * speedMultiplier);
 
-    if (closestSegDist < distanceTravelled)
+    // If it goes off to the left or right, remove it.  (The last
+    // spider moves into slot i, so look at slot i again.)
+    if (spider.pos.x < WORLD_LEFT_EDGE - 4 * worldConfig.colSpacing ||
+        spider.pos.x > WORLD_RIGHT_EDGE + 4 * worldConfig.colSpacing)
     {
+      removeSpider(i);
+      i--;
+      continue;
+    }
 
-      // Turn the hit segment into a mushroom (i.e. place a new
-      // mushroom at that position).  Place the new mushroom on one of
-      // the row/column points.
+    spiderGrid.move(i, spider.pos);
+    spiderStep = std::max(spiderStep, std::max(fabs(spider.pos.x - spider.prevPos.x), fabs(spider.pos.y - spider.prevPos.y)));
 
-      vec2 pos = closestCent->segments[closestSegIndex]->pos;
+    if (!playerInvulnerable && (spider.pos - player->pos).length() < (spider.radius() + 0.35f * worldConfig.rowSpacing))
+    {
+      // same logic you use for centipede head killing player
+      playerDied = true;
+      pauseForMessage = true;
+      pauseTimeRemaining = worldConfig.pauseTimeForMessage;
 
-      int col = rint((pos.x - WORLD_LEFT_EDGE) / COL_SPACING - 1);
-      int row = rint((WORLD_TOP_ROW - pos.y) / ROW_SPACING);
+      // remove spider so it doesn't keep colliding during the pause
+      removeSpider(i);
+      i--;
+    }
+  }
+}
 
-      vec2 worldPos(WORLD_LEFT_EDGE + (col + 1) * COL_SPACING, WORLD_TOP_ROW - row * ROW_SPACING); // (same code as in World constructor)
+// Remove spider i.  The last spider moves into its place, in the grid
+// as well.
 
-      mushrooms.add(new Mushroom(worldPos));
+void World::removeSpider(int i)
 
-      // a hit: Remove segment that was hit and split centipede into two.
+{
+  int last = spiders.size() - 1;
 
-      int tailCentSize = closestCent->segments.size() - 1 - closestSegIndex; // num of segs in (new) tail centipede
+  spiders.removeAt(i);
 
-      if (tailCentSize > 0)
-      { // The last segment wasn't hit, so create a centipede of the tail segments
+  spiderGrid.remove(i);
+  if (i != last)
+    spiderGrid.renumber(last, i);
+}
 
-        Centipede *newCent = new Centipede(tailCentSize, vec2(0, 0), vec2(0, 0));
+// Move each dart and check for it hitting a mushroom, a spider or a
+// centipede segment.
+//
+// If 'continuous', the test allows for the spiders and segments
+// having moved during the step as well: see dartCrossing().
+// Otherwise (as in the original game) a dart is tested against where
+// they are at the end of the step.
+//
+// This is done in two passes.  The detection pass finds what each
+// dart hits without changing anything, so the darts could be split
+// among threads.  The resolution pass then applies the hits one at a
+// time, in the order in which the darts were tested when they were
+// tested one at a time: in dart order, with the last dart taking the
+// place of one that is removed.  A hit that an earlier one in the
+// pass may have changed (see dartHitIsStale()) is found again first,
+// so the result is the same as testing and applying each dart in
+// turn.
+
+void World::updateDarts(float elapsedTime, bool continuous)
+{
+  PROFILE_SCOPE("darts");
 
-        for (int j = 0; j < tailCentSize; j++)
-          newCent->segments[j] = closestCent->segments[j + closestSegIndex + 1];
+  float distanceTravelled = worldConfig.dartSpeed * elapsedTime * speedMultiplier;
 
-        centipedes.add(newCent);
+  while (dartHits.size() < darts.size())
+    dartHits.add(DartHit());
 
-        // turn the new segment (only if not already turning
+  {
+    PROFILE_SCOPE("dart detection");
 
-        Segment *seg0 = newCent->segments[0];
+    for (int i = 0; i < darts.size(); i++)
+      dartHits[i] = findDartHit(darts[i].pos, distanceTravelled, continuous);
+  }
 
-        if (!seg0->turning)
-        {
-          seg0->turning = true; // start turning
-          seg0->turnAngle = 0;
-          seg0->turnCentre = vec2(seg0->pos.x, seg0->pos.y - CENTIPEDE_TURN_RADIUS);
-          seg0->dirUponTurnEntry = seg0->dir.x;
-          seg0->turningPositionX = seg0->pos.x;
-        }
-      }
+  PROFILE_SCOPE("dart resolution");
 
-      if (closestSegIndex == 0) // The first segment was hit, so just remove this centipede
+  spidersRemoved = false;
+  newMushrooms.clear();
 
-        centipedes.remove(centipedes.findIndex(closestCent));
+  for (int i = 0; i < darts.size(); i++)
+  {
+
+    // Move it
 
-      else // First segment not hit, so just truncate this centipede where it was hit
+    vec2 prevPos = darts[i].pos; // Get old location of dart.
+    darts[i].pos = darts[i].pos + vec2(0, distanceTravelled);
 
-        for (int j = 0; j < tailCentSize + 1; j++)
-          closestCent->segments.remove(); // removes the last segment
+    DartHit &hit = dartHits[i];
 
-      // Update score
+    if (dartHitIsStale(hit, prevPos, distanceTravelled))
+      hit = findDartHit(prevPos, distanceTravelled, continuous);
 
-      if (closestSegIndex)
-        score += SCORE_CENTIPEDE_HEAD;
-      else
-        score += SCORE_CENTIPEDE_SEGMENT;
+    if (hit.target != DartHit::NONE)
+      applyDartHit(hit);
 
-      // Remove dart
+    // Remove the dart if it hit something or went off the top
 
-      darts.remove(i);
+    if (hit.target != DartHit::NONE || darts[i].pos.y > WORLD_TOP_ROW)
+    {
+      removeDart(i);
       i--;
-      continue;
     }
   }
 
-  // See if a centipede's HEAD eats the player
+  // Squeeze the holes left by hit segments out of the segment store
+  // once they are half of it
 
-  for (int i = 0; i < centipedes.size(); i++)
-    if ((centipedes[i]->segments[0]->pos - player->pos).length() < 0.75 * ROW_SPACING)
-    {
+  if (segments.numHoles > segments.size() / 2)
+    compactSegments();
+}
 
-      chrono::system_clock::time_point t = chrono::system_clock::now();
+// What a dart at 'dartPos' hits as it moves up by 'distance', in the
+// world as it is.  This doesn't change anything.
 
-      t += chrono::duration<int>(PAUSE_TIME_FOR_MESSAGE);
+DartHit World::findDartHit(vec2 dartPos, float distance, bool continuous)
 
-      playerDied = true;
-      pauseForMessage = true;
-      pauseUntil = t;
+{
+  if (continuous)
+    return findDartHitContinuous(dartPos, distance);
 
-      break;
-    }
+  DartHit hit;
 
-  // Remove a life if player was destroyed
+  // Check for dart going off the top
 
-  if (playerDied)
+  if (dartPos.y + distance > WORLD_TOP_ROW)
+    return hit;
+
+  // See if there's a mushroom along the dart's path
+  vec2 dir(0, 1);
+  MushroomHandle closestHandle = findClosestMushroomAhead(dartPos, dir, worldConfig.rowSpacing / 4);
+  Mushroom *closestMush = mushrooms.get(closestHandle);
+
+  if (closestMush)
   {
 
-    livesRemaining--;
+    // See if this mushroom will be hit within the next time step
 
-    if (livesRemaining < 1)
+    vec2 v = closestMush->pos - dartPos;
+    float distAlongLine = v.x * dir.x + v.y * dir.y;
+    float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x);
+
+    if (distAlongLine > 0 && distAlongLine < distance && distPerpToLine < worldConfig.rowSpacing / 4)
     {
-      gameOver = true;
-      pauseForMessage = false;
+      hit.target = DartHit::MUSHROOM;
+      hit.mushroom = closestHandle;
+      return hit;
     }
   }
-  else if (!gameOver && centipedes.size() == 0)
-  { // end of level
 
-    // Add points for any remaining mushrooms.  Restore damaged mushrooms.
+  hit.spider = spiderHitByDart(dartPos, distance);
 
-    for (int i = 0; i < mushrooms.size(); i++)
-      mushrooms[i]->damage = 0;
+  if (hit.spider >= 0)
+  {
+    hit.target = DartHit::SPIDER;
+    return hit;
+  }
 
-    score += mushrooms.size() * SCORE_REMAINING_MUSHROOM;
+  // See if a centipede segment is hit
 
-    // Start next level if game isn't yet over
+  hit.segment = segmentHitByDart(dartPos, distance);
 
-    if (level < MAX_LEVEL)
-      level++;
+  if (hit.segment >= 0)
+    hit.target = DartHit::SEGMENT;
 
-    goToNextLevel = true;
-    pauseForMessage = true;
-    pauseUntil = chrono::system_clock::now() + chrono::seconds(PAUSE_TIME_FOR_MESSAGE);
+  return hit;
+}
+
+// Might 'hit', found for a dart at 'dartPos' at the start of the
+// resolution pass, have been changed by the hits applied since?
+//
+//   - a mushroom that a hit segment has turned into is in the dart's
+//     path (and might be closer than what it hit)
+//   - the mushroom that it hit has been destroyed
+//   - a spider has been removed (which renumbers the spiders, and of
+//     two spiders in reach the dart hits the first)
+//   - the segment that it hit has been hit already (removing a
+//     segment from the grid keeps the order of the others, so if two
+//     were equally close, the one it hit is still the one found)
+
+bool World::dartHitIsStale(const DartHit &hit, vec2 dartPos, float distance)
+
+{
+  for (int j = 0; j < newMushrooms.size(); j++)
+  {
+    vec2 v = newMushrooms[j] - dartPos;
+
+    if (v.y > 0 && v.y < distance && fabs(v.x) < worldConfig.rowSpacing / 4)
+      return true;
+  }
+
+  switch (hit.target)
+  {
+  case DartHit::MUSHROOM:
+    return mushrooms.get(hit.mushroom) == NULL;
+
+  case DartHit::SPIDER:
+    return spidersRemoved;
+
+  case DartHit::SEGMENT:
+    return segments.posY[hit.segment] == SEGMENT_HOLE_Y;
+
+  default:
+    return false;
   }
 }
 
-// Consider only the mushrooms that are within maxPerDist of the
-// line starting at position 'pos' in direction 'dir'.  Of those,
-// return the distance to the closest one.
+// Apply a dart's hit to what it hit
+
+void World::applyDartHit(const DartHit &hit)
 
-Mushroom *World::findClosestMushroomAhead(vec2 pos, vec2 dir, float maxPerpDist)
 {
-  float minDist = MAXFLOAT;
-  Mushroom *minMushroom;
+  switch (hit.target)
+  {
+  case DartHit::NONE:
+    break;
 
-  dir = dir.normalize();
+  case DartHit::MUSHROOM:
+    hitMushroom(hit.mushroom);
+    break;
 
-  for (int i = 0; i < mushrooms.size(); i++)
+  case DartHit::SPIDER:
+    score += SCORE_DESTROY_SPIDER;
+    removeSpider(hit.spider);
+    spidersRemoved = true;
+    break;
+
+  case DartHit::SEGMENT:
   {
+    int cent = centipedeOf(hit.segment);
+    MushroomHandle m = hitSegment(cent, hit.segment - centipedes[cent].first);
 
-    vec2 &mushPos = mushrooms[i]->pos; // use this below
+    newMushrooms.add(mushrooms.get(m)->pos);
+    break;
+  }
+  }
+}
 
-    // Test mushroom/ray here
-    vec2 v = mushPos - pos;
+// Remove dart i, moving the last dart (and its hit) into its place
 
-    float distAlongLine = v.x * dir.x + v.y * dir.y;        // [YOUR CODE HERE]
-    float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x); // [YOUR CODE HERE]
+void World::removeDart(int i)
 
-    if (distAlongLine > 0 && distPerpToLine < maxPerpDist)
+{
+  dartHits[i] = dartHits[darts.size() - 1];
+
+  darts.removeAt(i);
+}
+
+// The closest segment ahead of a dart at 'dartPos' that the dart
+// reaches within 'distance', or -1 if there's none.  Only the cells
+// along the dart's path, widened by a segment's radius, are looked
+// at.  Of equally close segments, the one with the lowest index wins,
+// whatever order they're in in the grid's cells.
+
+int World::segmentHitByDart(vec2 dartPos, float distance)
+
+{
+  double radius = SEG_BODY_RADIUS;
+
+  int c0 = segmentGrid.col(dartPos.x - radius);
+  int c1 = segmentGrid.col(dartPos.x + radius);
+  int r0 = segmentGrid.row(dartPos.y);
+  int r1 = segmentGrid.row(dartPos.y + distance);
+
+  int hitSeg = -1;
+  float hitDist = distance;
+
+  for (int r = r0; r <= r1; r++)
+    for (int c = c0; c <= c1; c++)
     {
+      UniformGrid::Cell &cell = segmentGrid.cell(r, c);
+
+      int closest;
+      float dist;
 
-      if (distAlongLine < minDist)
+      closestSegmentAhead(dartPos.x, dartPos.y, cell.x.array(), cell.y.array(), cell.size(), radius, closest, dist, cell.id.array());
+
+      if (closest >= 0 && (dist < hitDist || (dist == hitDist && hitSeg >= 0 && cell.id[closest] < hitSeg)))
       {
-        minDist = distAlongLine;
-        minMushroom = mushrooms[i];
+        hitSeg = cell.id[closest];
+        hitDist = dist;
       }
     }
-  }
 
-  if (minDist != MAXFLOAT)
-    return minMushroom;
-  else
-    return NULL;
+  return hitSeg;
 }
 
-// Draw the whole world, including its inhabitants.
+// The spider that a dart at 'dartPos' hits within 'distance', or -1
+// if there's none.  If it could hit several, it's the one that comes
+// first in 'spiders', as it was when every spider was tested.
 
-void World::draw()
+int World::spiderHitByDart(vec2 dartPos, float distance)
 
 {
-  glClearColor(BACKGROUND_COLOUR.x, BACKGROUND_COLOUR.y, BACKGROUND_COLOUR.z, 0);
-  glClear(GL_COLOR_BUFFER_BIT);
+  float radius = SPIDER_RADIUS;
 
-  setWindowEdgeCoordinates();
+  int c0 = spiderGrid.col(dartPos.x - radius);
+  int c1 = spiderGrid.col(dartPos.x + radius);
+  int r0 = spiderGrid.row(dartPos.y);
+  int r1 = spiderGrid.row(dartPos.y + distance);
 
-  mat4 VP = ortho(l, r, b, t, 0, 1);
+  int hitSpider = -1;
 
-  // Draw everything
+  for (int r = r0; r <= r1; r++)
+    for (int c = c0; c <= c1; c++)
+    {
+      UniformGrid::Cell &cell = spiderGrid.cell(r, c);
 
-  gpuProg->activate();
+      for (int k = 0; k < cell.size(); k++)
+      {
+        int j = cell.id[k];
 
-  for (int i = 0; i < mushrooms.size(); i++)
-    mushrooms[i]->draw(VP);
+        float distAlongLine = cell.y[k] - dartPos.y;
+        float distPerpToLine = fabs(cell.x[k] - dartPos.x);
 
-  for (int i = 0; i < centipedes.size(); i++)
-    centipedes[i]->draw(VP);
+        if (distAlongLine > 0 && distAlongLine < distance && distPerpToLine < spiders[j].radius() &&
+            (hitSpider < 0 || j < hitSpider))
+          hitSpider = j;
+      }
+    }
 
-  if (player)
-    player->draw(VP);
+  return hitSpider;
+}
 
-  for (int i = 0; i < darts.size(); i++)
-    darts[i]->draw(VP);
+// The centipede (its index in 'centipedes') whose span of the segment
+// store contains segment 'seg'
+
+int World::centipedeOf(int seg)
+
+{
+  int cent = 0;
+
+  while (seg < centipedes[cent].first || seg >= centipedes[cent].first + centipedes[cent].numSegs)
+    cent++;
+
+  return cent;
+}
 
-  if (spider)
-    spider->draw(VP);
+// Does a dart that moves up by 'distance' during a step, from
+// 'dartPos', cross a target that moves from 'from' to 'to' during the
+// same step?  Both are taken to move in straight lines at constant
+// speed.  The dart crosses the target when it passes the target's
+// centre height, and hits it if it is within 'radius' of the centre
+// horizontally then.  If so, 't' is the fraction of the step at
+// which that happens.
+//
+// This is the test of the original game with the target's movement
+// added: a target that is still is hit under the same conditions.
 
-  // Show lives remaining in upper-left corner
+static bool dartCrossing(vec2 dartPos, float distance, vec2 from, vec2 to, float radius, float &t)
 
-  for (int i = 0; i < livesRemaining - 1; i++)
+{
+  // Target relative to the dart: 'ahead' at the start of the step,
+  // closing at 'closing' over the step
+
+  float aheadY = from.y - dartPos.y;
+  float closingY = distance - (to.y - from.y);
+
+  if (aheadY <= 0 || closingY <= 0 || aheadY >= closingY)
+    return false; // behind the dart, pulling away, or not reached in this step
+
+  t = aheadY / closingY;
+
+  float x = from.x + t * (to.x - from.x);
+
+  return fabs(x - dartPos.x) < radius;
+}
+
+// The continuous test for a dart: the first mushroom, spider or
+// segment that the dart hits during the step.  Of spiders or of
+// segments hit at the same time, the one with the lowest index wins.
+
+DartHit World::findDartHitContinuous(vec2 dartPos, float distance)
+
+{
+  DartHit hit;
+
+  float firstT = 1;
+  float t;
+
+  // Mushrooms don't move
+
+  MushroomHandle closestHandle = findClosestMushroomAhead(dartPos, vec2(0, 1), worldConfig.rowSpacing / 4);
+  Mushroom *closestMush = mushrooms.get(closestHandle);
+
+  if (closestMush)
   {
-    mat4 T = translate(WORLD_LEFT_EDGE + 1 * COL_SPACING + i * 0.7 * COL_SPACING - player->pos.x, TOP_TEXT_Y - player->pos.y + TEXT_SIZE / 2.0, 0);
-    mat4 VP2 = VP * T;
-    player->draw(VP2);
+    vec2 v = closestMush->pos - dartPos;
+
+    if (v.y > 0 && v.y < distance && fabs(v.x) < worldConfig.rowSpacing / 4)
+    {
+      hit.target = DartHit::MUSHROOM;
+      hit.mushroom = closestHandle;
+      firstT = v.y / distance;
+    }
   }
 
-  // Done drawing geometry
+  // Spiders and segments that the dart crosses were, at the crossing,
+  // in the cells along its path, and they have since moved by at
+  // most a step
+
+  float reach = SPIDER_RADIUS + spiderStep;
+
+  int c0 = spiderGrid.col(dartPos.x - reach);
+  int c1 = spiderGrid.col(dartPos.x + reach);
+  int r0 = spiderGrid.row(dartPos.y - spiderStep);
+  int r1 = spiderGrid.row(dartPos.y + distance + spiderStep);
+
+  for (int r = r0; r <= r1; r++)
+    for (int c = c0; c <= c1; c++)
+    {
+      UniformGrid::Cell &cell = spiderGrid.cell(r, c);
+
+      for (int k = 0; k < cell.size(); k++)
+      {
+        Spider &spider = spiders[cell.id[k]];
 
-  gpuProg->deactivate();
+        if (dartCrossing(dartPos, distance, spider.prevPos, spider.pos, spider.radius(), t) &&
+            (t < firstT || (t == firstT && hit.target == DartHit::SPIDER && cell.id[k] < hit.spider)))
+        {
+          hit.target = DartHit::SPIDER;
+          firstT = t;
+          hit.spider = cell.id[k];
+        }
+      }
+    }
 
-  // Draw status at top
+  float *segPrevX = segments.prevX.array();
+  float *segPrevY = segments.prevY.array();
+  float segRadius = SEG_BODY_RADIUS;
 
-  fontGPUProg->activate();
+  reach = segRadius + segmentStep;
 
-  if (!gameOver)
-  { // game is still running
+  c0 = segmentGrid.col(dartPos.x - reach);
+  c1 = segmentGrid.col(dartPos.x + reach);
+  r0 = segmentGrid.row(dartPos.y - segmentStep);
+  r1 = segmentGrid.row(dartPos.y + distance + segmentStep);
 
-    { // Draw score in middle
+  for (int r = r0; r <= r1; r++)
+    for (int c = c0; c <= c1; c++)
+    {
+      UniformGrid::Cell &cell = segmentGrid.cell(r, c);
 
-      stringstream ss;
-      ss << "Score " << score;
-      string str = ss.str();
+      for (int k = 0; k < cell.size(); k++)
+      {
+        int seg = cell.id[k];
 
-      drawStrokeString(str,
-                       -((str.length() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y, // centre the string at top of window
-                       TEXT_SIZE);
+        if (dartCrossing(dartPos, distance, vec2(segPrevX[seg], segPrevY[seg]), vec2(cell.x[k], cell.y[k]), segRadius, t) &&
+            (t < firstT || (t == firstT && hit.target == DartHit::SEGMENT && seg < hit.segment)))
+        {
+          hit.target = DartHit::SEGMENT;
+          firstT = t;
+          hit.segment = seg;
+        }
+      }
     }
 
-    { // Draw level or right
+  return hit;
+}
+
+// A dart has hit a mushroom: damage it, and destroy it after
+// MUSH_MAX_DAMAGE hits
+
+void World::hitMushroom(MushroomHandle h)
+
+{
+  Mushroom *mush = mushrooms.get(h);
+
+  mush->damage += 1;
+
+  if (mush->damage >= MUSH_MAX_DAMAGE)
+  { // mushroom is destroyed
+    score += SCORE_DESTROY_MUSHROOM;
+    removeMushroom(h);
+  }
+}
+
+// A dart has hit segment 'segIndex' of centipede 'cent': the segment
+// becomes a mushroom and the centipede is split in two there.
+// Returns the new mushroom.
+
+MushroomHandle World::hitSegment(int cent, int segIndex)
+
+{
+  // Turn the hit segment into a mushroom (i.e. place a new
+  // mushroom at that position).  Place the new mushroom on one of
+  // the row/column points.
+
+  int hit = centipedes[cent].first + segIndex; // in 'segments'
+
+  vec2 pos = segments.pos(hit);
+
+  int col = rint((pos.x - WORLD_LEFT_EDGE) / worldConfig.colSpacing - 1);
+  int row = rint((WORLD_TOP_ROW - pos.y) / worldConfig.rowSpacing);
 
-      stringstream ss;
-      ss << "Level " << level + 1;
-      string str = ss.str();
+  vec2 worldPos(WORLD_LEFT_EDGE + (col + 1) * worldConfig.colSpacing, WORLD_TOP_ROW - row * worldConfig.rowSpacing); // (same code as in World constructor)
 
-      drawStrokeString(str,
-                       WORLD_RIGHT_EDGE + COL_SPACING - ((str.length() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y, // centre the string at top of window
-                       TEXT_SIZE);
+  MushroomHandle mushroom = addMushroom(worldPos);
+
+  // a hit: Remove segment that was hit and split centipede into
+  // two.  The segments after the hit one become the span of a new
+  // centipede, and the hit one is left as a hole.
+
+  int tailCentSize = centipedes[cent].numSegs - 1 - segIndex; // num of segs in (new) tail centipede
+
+  segments.makeHole(hit);
+  segmentGrid.remove(hit);
+
+  if (tailCentSize > 0)
+  { // The last segment wasn't hit, so create a centipede of the tail segments
+
+    Centipede newCent = centipedes[cent].tail(segIndex + 1, segments);
+
+    // turn the new segment (only if not already turning
+
+    int seg0 = newCent.first;
+
+    if (!segments.turning[seg0])
+    {
+      segments.turning[seg0] = true; // start turning
+      segments.turnAngle[seg0] = 0;
+      segments.turnCentreX[seg0] = segments.posX[seg0];
+      segments.turnCentreY[seg0] = segments.posY[seg0] - CENTIPEDE_TURN_RADIUS;
+      segments.dirUponTurnEntry[seg0] = segments.dirX[seg0];
     }
+
+    centipedes.add(newCent);
   }
+
+  if (segIndex == 0) // The first segment was hit, so just remove this centipede
+
+    removeCentipede(cent);
+
+  else // First segment not hit, so just truncate this centipede where it was hit
+
+    centipedes[cent].numSegs = segIndex;
+
+  // Update score
+
+  if (segIndex)
+    score += SCORE_CENTIPEDE_HEAD;
   else
-  { // game is over
+    score += SCORE_CENTIPEDE_SEGMENT;
 
-    stringstream ss;
-    ss << "GAME OVER     Score " << score << "     Press s to start";
-    string str = ss.str();
+  return mushroom;
+}
 
-    drawStrokeString(str,
-                     WORLD_LEFT_EDGE - 2.5 * COL_SPACING, TOP_TEXT_Y, // centre the string at top of window
-                     TEXT_SIZE);
-  }
+// Move the centipedes' spans of segments down to fill the holes
+// between them, keeping each span in order.  (The order of the
+// centipedes in 'centipedes' doesn't change.)
 
-  // Show any message for which we're pausing on a line below the top line
+void World::compactSegments()
 
-  if (pauseForMessage)
+{
+  PROFILE_SCOPE("compact segments");
+
+  // Centipedes in order of their spans, so that each span moves down
+  // (or stays put) and never over a span that hasn't moved yet
+
+  seq<int> &order = compactOrder;
+
+  order.clear();
+
+  for (int i = 0; i < centipedes.size(); i++)
+    order.add(i);
+
+  std::sort(order.array(), order.array() + order.size(),
+            [this](int a, int b) { return centipedes[a].first < centipedes[b].first; });
+
+  int next = 0;
+
+  for (int i = 0; i < order.size(); i++)
   {
+    Centipede &cent = centipedes[order[i]];
 
-    if (chrono::system_clock::now() > pauseUntil)
+    if (cent.first != next)
+      for (int j = 0; j < cent.numSegs; j++)
+      {
+        segments.move(next + j, cent.first + j);
+        segmentGrid.renumber(cent.first + j, next + j);
+      }
 
-      // pause is over, so start a new level
+    cent.first = next;
+    next += cent.numSegs;
+  }
 
-      initLevel();
+  segments.truncate(next);
+  segments.numHoles = 0;
+}
 
-    else if (playerDied)
-    {
+// Consider only the mushrooms that are within maxPerDist of the
+// line starting at position 'pos' in direction 'dir'.  Of those,
+// return the distance to the closest one.
 
-      // pausing after player died
+MushroomHandle World::findClosestMushroomAhead(vec2 pos, vec2 dir, float maxPerpDist)
+{
+  float minDist = MAXFLOAT;
+  MushroomHandle minMushroom;
 
-      string str = "YOU DIED";
-      drawStrokeString(str,
-                       -((str.length() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y - ROW_SPACING,
-                       TEXT_SIZE);
-    }
-    else if (goToNextLevel)
-    {
+  dir = dir.normalize();
+
+  // The grid answers queries along a row or column
+
+  MushroomHandle closest;
+
+  if (useStandardGrid ? standardGrid.findClosestAhead(pos, dir, maxPerpDist, closest)
+                      : runtimeGrid.findClosestAhead(pos, dir, maxPerpDist, closest))
+    return closest;
 
-      // pausing after level ended
+  // Otherwise test every mushroom.  Of equally close mushrooms, take
+  // the one added first (as the grid does), since the order of
+  // 'mushrooms' changes as mushrooms are removed.
 
-      string str = "END OF LEVEL";
-      drawStrokeString(str,
-                       -((str.length() - 1) * TEXT_SIZE / 2.0), TOP_TEXT_Y - ROW_SPACING,
-                       TEXT_SIZE);
+  unsigned int minSerial = 0;
+
+  for (int i = 0; i < mushrooms.size(); i++)
+  {
+
+    vec2 &mushPos = mushrooms[i].pos; // use this below
+
+    // Test mushroom/ray here
+    vec2 v = mushPos - pos;
+
+    float distAlongLine = v.x * dir.x + v.y * dir.y;        // [YOUR CODE HERE]
+    float distPerpToLine = fabs(v.x * dir.y - v.y * dir.x); // [YOUR CODE HERE]
+
+    if (distAlongLine > 0 && distPerpToLine < maxPerpDist)
+    {
+
+      if (distAlongLine < minDist || (distAlongLine == minDist && mushrooms[i].serial < minSerial))
+      {
+        minDist = distAlongLine;
+        minMushroom = mushrooms.handle(i);
+        minSerial = mushrooms[i].serial;
+      }
     }
   }
 
-  fontGPUProg->deactivate();
+  return minMushroom;
 }
 
-// Find the coordinates of the window edges so that the game window
-// fits in an area with coordinates [-GAME_ASPECT,+GAME_ASPECT] x [-1,1].
+// Copy everything the renderer needs into 'snap'.  This is called
+// on the simulation thread after each tick; the renderer only ever
+// sees the copy.  Its sequences keep their storage from one tick to
+// the next.
 
-void World::setWindowEdgeCoordinates()
+void World::publishSnapshot(RenderSnapshot &snap)
 
 {
-  int width, height;
-  glfwGetFramebufferSize(window, &width, &height);
+  snap.mushrooms.clear();
+  for (int i = 0; i < mushrooms.size(); i++)
+  {
+    MushroomState m;
+    m.pos = mushrooms[i].pos;
+    m.damage = mushrooms[i].damage;
+    snap.mushrooms.add(m);
+  }
 
-  float windowAspect = width / (float)height; // aspect ratio of screen window
-  float totalAspect = GAME_ASPECT;
+  snap.segments.clear();
+  for (int i = 0; i < centipedes.size(); i++)
+  {
+    Centipede &cent = centipedes[i];
+    for (int j = 0; j < cent.numSegs; j++)
+    {
+      SegmentState s;
+      s.pos = segments.pos(cent.first + j);
+      s.dir = segments.dir(cent.first + j);
+      s.isHead = (j == 0);
+      s.phase = cent.phase - j * PHASE_DELTA_PER_SEG; // phase varies with segment to make legs ripple
+      snap.segments.add(s);
+    }
+  }
 
-  if (totalAspect > windowAspect)
-  { // game should resize to fit horizontally in screen window
+  snap.darts.clear();
+  for (int i = 0; i < darts.size(); i++)
+    snap.darts.add(darts[i].pos);
 
-    l = -GAME_ASPECT;
-    r = -l;
+  snap.playerPos = player->pos;
 
-    b = l / windowAspect;
-    t = -b;
+  snap.spiders.clear();
+  for (int i = 0; i < spiders.size(); i++)
+  {
+    SpiderState s;
+    s.pos = spiders[i].pos;
+    s.vel = spiders[i].vel;
+    snap.spiders.add(s);
   }
-  else
-  { // game should resize vertically to fit  in screen window
 
-    b = -1;
-    t = +1;
+  snap.score = score;
+  snap.level = level;
+  snap.livesRemaining = livesRemaining;
 
-    l = b * windowAspect;
-    r = -l;
-  }
+  snap.gameOver = gameOver;
+  snap.pauseForMessage = pauseForMessage;
+  snap.playerDied = playerDied;
+  snap.goToNextLevel = goToNextLevel;
+
+  snap.tick = tick;
 }
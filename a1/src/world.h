@@ -6,17 +6,30 @@
 #include "headers.h"
 #include "main.h"
 #include "seq.h"
+#include "slotmap.h"
 #include "centipede.h"
 #include "mushroom.h"
 #include "player.h"
 #include "dart.h"
 #include "worldDefs.h"
 #include "spider.h"
+#include "snapshot.h"
+#include "mushroomgrid.h"
+#include "uniformgrid.h"
 
-class World
+// What a dart hits in a step (see World::updateDarts)
+
+struct DartHit
 {
+  enum { NONE, MUSHROOM, SPIDER, SEGMENT } target = NONE;
+
+  MushroomHandle mushroom;
+  int spider = -1;  // index in World::spiders
+  int segment = -1; // index in World::segments
+};
 
-  GLFWwindow *window;
+class World
+{
 
   int score;
   int numCols;
@@ -25,30 +38,85 @@ class World
   bool goToNextLevel;
 
   bool pauseForMessage;
-  chrono::system_clock::time_point pauseUntil;
-
-  seq<Centipede *> centipedes;
-  seq<Mushroom *> mushrooms;
+  float pauseTimeRemaining; // seconds of simulation time until the message pause ends
+
+  // The entities, each type in its own SlotMap.  A pointer or index
+  // into one of these is only good until the next add or remove; hold
+  // a Handle to refer to an entity for longer.
+
+  SlotMap<Centipede> centipedes;
+  SegmentStore segments; // of all the centipedes
+  SlotMap<Mushroom> mushrooms;
+
+  // Mushrooms indexed by grid cell.  The standard grid has its size
+  // fixed at compile time, and is used whenever the world config has
+  // the default grid.
+
+  MushroomGrid<StandardGrid> standardGrid;
+  MushroomGrid<RuntimeGrid> runtimeGrid;
+  bool useStandardGrid;
+
+  // Segments (by index in 'segments') and spiders (by index in
+  // 'spiders') indexed by grid cell, for the dart tests.  These are
+  // kept up to date as they move (see uniformgrid.h).
+
+  UniformGrid segmentGrid;
+  UniformGrid spiderGrid;
+  float segmentStep; // furthest a segment moved in the last step (for the continuous dart test)
+  float spiderStep;  // furthest a spider moved in the last step
+
+  void reserveEntities();
+  void clearMushrooms();
+  void removeCentipede(int i);
+  void clearCentipedes();
+  void removeMushroom(MushroomHandle h);
+  void compactSegments();
+  seq<int> compactOrder; // (scratch for compactSegments)
+  void moveCentipedes(float elapsedTime);
+  int numSubsteps(float elapsedTime);
+  void updateSegmentGrid(bool continuous);
+  int segmentHitByDart(vec2 dartPos, float distance);
+  int spiderHitByDart(vec2 dartPos, float distance);
+  DartHit findDartHit(vec2 dartPos, float distance, bool continuous);
+  DartHit findDartHitContinuous(vec2 dartPos, float distance);
+  bool dartHitIsStale(const DartHit &hit, vec2 dartPos, float distance);
+  void applyDartHit(const DartHit &hit);
+  int centipedeOf(int seg);
+  void removeSpider(int i);
+  void hitMushroom(MushroomHandle h);
+  MushroomHandle hitSegment(int cent, int segIndex);
   Player *player;
-  seq<Dart *> darts;
-  Spider *spider;
+  SlotMap<Dart> darts;
+  void removeDart(int i);
+
+  // State of the detection and resolution passes of updateDarts
+
+  seq<DartHit> dartHits; // by dart, as found by the detection pass
+  seq<vec2> newMushrooms; // made by hit segments during the resolution pass
+  bool spidersRemoved;    //   and whether a spider has been removed
+  SlotMap<Spider> spiders;
   float spiderSpawnTimer;
 
-  Mushroom *highlightMushroom; // mushroom to highlight (for debugging)
+  MushroomHandle highlightMushroom; // mushroom to highlight (for debugging)
 
 public:
   int level;
   int livesRemaining;
   bool gameOver;
 
-  float l, r, b, t; // coordinates of window edges
+  unsigned int tick; // number of calls to updateState()
+  unsigned int levelsStarted; // number of calls to initLevel()
 
-  World(GLFWwindow *w)
+  bool playerInvulnerable; // ignore collisions with the player (for the stress benchmark)
+
+  World() : standardGrid(mushrooms), runtimeGrid(mushrooms)
   {
-    initWorld(w);
+    player = NULL;
+    levelsStarted = 0;
+    initWorld();
   }
 
-  void initWorld(GLFWwindow *w);
+  void initWorld();
 
   void initLevel()
   {
@@ -56,13 +124,17 @@ public:
     // Start with one centipede.  With each new level, make the
     // centipede one segment shorter AND create a length-one centipede
 
-    centipedes.clear();
+    levelsStarted++;
+
+    clearCentipedes();
+    segments.clear();
+    segmentGrid.clear();
 
-    centipedes.add(new Centipede(MAX_CENTIPEDE_SEGMENTS - level, INIT_CENTIPEDE_POS, INIT_CENTIPEDE_DIR));
+    addCentipede(worldConfig.maxCentipedeSegments - level, INIT_CENTIPEDE_POS, INIT_CENTIPEDE_DIR);
     for (int i = 0; i < level; i++) // might at centipedes on top of each other ... would be easy to fix.
-      centipedes.add(new Centipede(1,
-                                   vec2(WORLD_LEFT_EDGE + (randIn01() * (numCols - 1) + 0.5) * COL_SPACING, INIT_CENTIPEDE_POS.y),
-                                   vec2(randIn01() > 0.5 ? 1 : -1, INIT_CENTIPEDE_DIR.y)));
+      addCentipede(1,
+                   vec2(WORLD_LEFT_EDGE + (randIn01() * (numCols - 1) + 0.5) * worldConfig.colSpacing, INIT_CENTIPEDE_POS.y),
+                   vec2(randIn01() > 0.5 ? 1 : -1, INIT_CENTIPEDE_DIR.y));
     // One player
 
     if (!player)
@@ -77,41 +149,45 @@ public:
     // Start level with no darts, fleas, spiders
 
     darts.clear();
-
-    // Set up the window
-
-    setWindowEdgeCoordinates();
   }
 
+  // Move the player toward 'pos', which is already in world
+  // coordinates (the window-to-world conversion is done on the thread
+  // that owns the window).
+
   void playerMove(vec2 pos)
   {
-
-    int winX, winY;
-    glfwGetWindowSize(window, &winX, &winY);
-
-    // [YOUR CODE HERE]
-    //
-    // Convert the mouse position 'pos' into a world position.  Use
-    // the window size 'winX' and 'winY' and use the world coordinates
-    // of the window edges (defined above).
-
-    float worldX = ((2.0f * pos.x) / winX) - 1.0f;
-    float worldY = ((-2.0f * pos.y) / winY) + 1.0f;
-
-    player->moveTo(vec2(worldX, worldY));
+    player->moveTo(pos);
   }
 
   void playerFire()
   {
 
-    if (darts.size() < MAX_DARTS_AT_ONCE)
-      darts.add(new Dart(player->pos));
+    if (darts.size() < worldConfig.maxDartsAtOnce)
+      darts.add(Dart(player->pos));
   }
 
-  void draw();
+  // Scenario set-up for the benchmarks.  These bypass the usual
+  // limits, such as worldConfig.maxDartsAtOnce.
+
+  void clearEntities();
+  MushroomHandle addMushroom(vec2 pos);
+  void addCentipede(int numSegs, vec2 headPos, vec2 dir);
+  void addDart(vec2 pos) { darts.add(Dart(pos)); }
+  void addSpider(vec2 pos, vec2 vel);
+
+  int numCentipedes() { return centipedes.size(); }
+  int numMushrooms() { return mushrooms.size(); }
+  int numDarts() { return darts.size(); }
+  int numSpiders() { return spiders.size(); }
+  int numSegments();
+
   void updateState(float elapsedTime);
-  void setWindowEdgeCoordinates();
-  Mushroom *findClosestMushroomAhead(vec2 pos, vec2 dir, float maxPerpDist);
+  void updateSpider(float elapsedTime);
+  void updateDarts(float elapsedTime, bool continuous = false);
+  void publishSnapshot(RenderSnapshot &snap);
+  MushroomHandle findClosestMushroomAhead(vec2 pos, vec2 dir, float maxPerpDist);
+  Mushroom *mushroom(MushroomHandle h) { return mushrooms.get(h); } // NULL if it has been destroyed
   int lowerMushroomCount();
 };
 
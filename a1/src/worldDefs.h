@@ -1,50 +1,42 @@
 // worldDefs.h
+//
+// The grid size, the load and the speeds are set at run time: see
+// worldconfig.h.
 
-#define GAME_ASPECT 0.75 // width/height ratio of game
+#include "worldconfig.h"
 
-#define NUM_ROWS 20
+#define GAME_ASPECT 0.75 // width/height ratio of game
 
-#define ROW_SPACING 0.07
-#define COL_SPACING 0.07
+#define DEFAULT_NUM_ROWS 20      // the default grid (see WorldConfig)
+#define DEFAULT_ROW_SPACING 0.07
+#define DEFAULT_COL_SPACING 0.07
 
 #define TOP_TEXT_Y 0.9
 
 #define WORLD_TOP_ROW 0.8
-#define WORLD_BOTTOM_ROW (WORLD_TOP_ROW - (NUM_ROWS - 1) * ROW_SPACING)
+#define WORLD_BOTTOM_ROW (WORLD_TOP_ROW - (worldConfig.numRows - 1) * worldConfig.rowSpacing)
 
 #define WORLD_LEFT_EDGE (-GAME_ASPECT)
 #define WORLD_RIGHT_EDGE GAME_ASPECT
 
 #define PIECES_PER_CIRCLE 32 // number of straight pieces with which to approximate a circle
 
-#define PAUSE_TIME_FOR_MESSAGE 2 // whole seconds only!
-
-#define MAX_CENTIPEDE_SEGMENTS 10
-#define MAX_LEVEL (MAX_CENTIPEDE_SEGMENTS - 1)
-
-#define CENTIPEDE_INIT_SPEED 0.4 // distance per second in WCS
-#define CENTIPEDE_SPEED_INC_PER_LEVEL 0.1
+#define SIM_TICKS_PER_SECOND 120 // fixed rate of the simulation thread, independent of the display
+#define MAX_SUBSTEPS 256         // most substeps in one sped-up tick (see World::numSubsteps)
 
 #define INIT_CENTIPEDE_POS vec2(0.4, WORLD_TOP_ROW)
 #define INIT_CENTIPEDE_DIR vec2(1.0, 0.0)
 
-#define INIT_NUM_MUSHROOMS 60
 #define MUSH_MAX_DAMAGE 4 // number of hits before mushroom is destroyed
 
-#define INIT_LIVES_REMAINING 3
-
 #define INIT_PLAYER_POS vec2(0.0, -0.9)
 
-#define MAX_DARTS_AT_ONCE 3
-
 #define SCORE_DESTROY_MUSHROOM 1
 #define SCORE_REMAINING_MUSHROOM 5
 #define SCORE_CENTIPEDE_HEAD 100
 #define SCORE_CENTIPEDE_SEGMENT 10
 
-#define SPIDER_RADIUS (0.35f * ROW_SPACING)
-#define SPIDER_SPEED_X (0.60f) // WCS units per second
-#define SPIDER_SPEED_Y (0.40f)
-#define SPIDER_Y_MIN (-1.0f + 1.5f * ROW_SPACING)
-#define SPIDER_Y_MAX (WORLD_BOTTOM_ROW + 2.0f * ROW_SPACING) // keeps it in player-ish area
+#define SPIDER_RADIUS (0.35f * worldConfig.rowSpacing)
+#define SPIDER_Y_MIN (-1.0f + 1.5f * worldConfig.rowSpacing)
+#define SPIDER_Y_MAX (WORLD_BOTTOM_ROW + 2.0f * worldConfig.rowSpacing) // keeps it in player-ish area
 #define SCORE_DESTROY_SPIDER 300
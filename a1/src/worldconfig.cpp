@@ -0,0 +1,256 @@
+// worldconfig.cpp
+
+
+#include "worldconfig.h"
+#include "headers.h"
+#include "worldDefs.h"
+
+#include <fstream>
+#include <sstream>
+
+
+WorldConfig worldConfig;
+
+
+WorldConfig::WorldConfig()
+
+{
+  numRows = DEFAULT_NUM_ROWS;
+  rowSpacing = DEFAULT_ROW_SPACING;
+  colSpacing = DEFAULT_COL_SPACING;
+
+  initNumMushrooms = 60;
+  maxCentipedeSegments = 10;
+  maxDartsAtOnce = 3;
+  maxSpidersAtOnce = 1;
+  initLivesRemaining = 3;
+
+  centipedeInitSpeed = 0.4;
+  centipedeSpeedIncPerLevel = 0.1;
+  dartSpeed = 4.0;
+  spiderSpeedX = 0.60f;
+  spiderSpeedY = 0.40f;
+
+  spiderFirstSpawn = 3.0f;
+  spiderSpawnMin = 6.0f;
+  spiderSpawnRange = 6.0f;
+  pauseTimeForMessage = 2;
+
+  analyticMotion = 0;
+
+  threads = 0;
+  parallelSegments = 2000;
+}
+
+
+// The settable fields, with their ranges.  Fills in 'f' (which must
+// have room for all of them) and returns the number of fields.
+
+int WorldConfig::fields( Field *f )
+
+{
+  Field all[] = {
+    { "rows",                  INT_FIELD,    &numRows,                   2, 1000,  "number of rows of mushrooms" },
+    { "rowSpacing",            DOUBLE_FIELD, &rowSpacing,                0.001, 1, "distance between rows" },
+    { "colSpacing",            DOUBLE_FIELD, &colSpacing,                0.001, 1, "distance between columns (sets the number of columns)" },
+    { "mushrooms",             INT_FIELD,    &initNumMushrooms,          0, 1e7,   "number of mushrooms to place (duplicates are skipped)" },
+    { "segments",              INT_FIELD,    &maxCentipedeSegments,      1, 1e6,   "segments in the level-1 centipede" },
+    { "darts",                 INT_FIELD,    &maxDartsAtOnce,            0, 1e6,   "darts in the air at once" },
+    { "spiders",               INT_FIELD,    &maxSpidersAtOnce,          0, 1e6,   "spiders at once" },
+    { "lives",                 INT_FIELD,    &initLivesRemaining,        1, 1000,  "lives at the start of a game" },
+    { "centipedeSpeed",        DOUBLE_FIELD, &centipedeInitSpeed,        0.001, 100, "level-1 centipede speed" },
+    { "centipedeSpeedPerLevel",DOUBLE_FIELD, &centipedeSpeedIncPerLevel, 0, 100,   "centipede speed increase per level" },
+    { "dartSpeed",             DOUBLE_FIELD, &dartSpeed,                 0.001, 1000, "dart speed" },
+    { "spiderSpeedX",          FLOAT_FIELD,  &spiderSpeedX,              0.001, 100, "spider horizontal speed" },
+    { "spiderSpeedY",          FLOAT_FIELD,  &spiderSpeedY,              0, 100,   "spider vertical speed" },
+    { "spiderFirstSpawn",      FLOAT_FIELD,  &spiderFirstSpawn,          0, 1e6,   "seconds before the first spider" },
+    { "spiderSpawnMin",        FLOAT_FIELD,  &spiderSpawnMin,            0, 1e6,   "minimum seconds between spiders" },
+    { "spiderSpawnRange",      FLOAT_FIELD,  &spiderSpawnRange,          0, 1e6,   "random extra seconds between spiders" },
+    { "messagePause",          DOUBLE_FIELD, &pauseTimeForMessage,       0, 60,    "seconds to show a message between levels" },
+    { "analyticMotion",        INT_FIELD,    &analyticMotion,            0, 1,     "1 to move centipedes event by event, independent of step size" },
+    { "threads",               INT_FIELD,    &threads,                   0, 256,   "threads in the job pool (0 for one per core)" },
+    { "parallelSegments",      INT_FIELD,    &parallelSegments,          0, 1e9,   "segments at which centipedes are updated in parallel (0 for never)" }
+  };
+
+  int n = sizeof(all) / sizeof(all[0]);
+
+  if (f)
+    for (int i=0; i<n; i++)
+      f[i] = all[i];
+
+  return n;
+}
+
+
+WorldConfig::Field *WorldConfig::findField( const char *name, Field *f, int n )
+
+{
+  for (int i=0; i<n; i++)
+    if (strcmp( f[i].name, name ) == 0)
+      return &f[i];
+
+  return NULL;
+}
+
+
+// Set one field from a string.  Each field is checked against its
+// range here; validate() checks how the fields fit together.
+
+bool WorldConfig::set( const char *name, const char *value )
+
+{
+  Field f[32];
+  int n = fields( f );
+
+  Field *field = findField( name, f, n );
+
+  if (field == NULL) {
+    cerr << "WorldConfig: Unknown setting '" << name << "' (use \"-config help\" for the list)" << endl;
+    return false;
+  }
+
+  char *end;
+  double v = strtod( value, &end );
+
+  if (end == value || *end != '\0' || (field->type == INT_FIELD && v != floor( v ))) {
+    cerr << "WorldConfig: Bad value '" << value << "' for " << name << endl;
+    return false;
+  }
+
+  if (v < field->min || v > field->max) {
+    cerr << "WorldConfig: " << name << " must be in [" << field->min << "," << field->max << "]" << endl;
+    return false;
+  }
+
+  switch (field->type) {
+  case INT_FIELD:    * (int *)    field->value = (int) v;   break;
+  case FLOAT_FIELD:  * (float *)  field->value = (float) v; break;
+  case DOUBLE_FIELD: * (double *) field->value = v;         break;
+  }
+
+  return true;
+}
+
+
+bool WorldConfig::set( const char *assignment )
+
+{
+  const char *eq = strchr( assignment, '=' );
+
+  if (eq == NULL) {
+    cerr << "WorldConfig: Expected name=value, not '" << assignment << "'" << endl;
+    return false;
+  }
+
+  string name( assignment, eq - assignment );
+  return set( name.c_str(), eq+1 );
+}
+
+
+bool WorldConfig::load( const char *filename )
+
+{
+  ifstream in( filename );
+
+  if (!in) {
+    cerr << "WorldConfig: Could not open " << filename << endl;
+    return false;
+  }
+
+  string line;
+  int lineNum = 0;
+
+  while (getline( in, line )) {
+
+    lineNum++;
+
+    size_t hash = line.find( '#' );
+    if (hash != string::npos)
+      line.erase( hash );
+
+    istringstream words( line );
+    string name, value, extra;
+
+    if (!(words >> name))
+      continue; // blank line
+
+    if (!(words >> value) || (words >> extra)) {
+      cerr << "WorldConfig: " << filename << ":" << lineNum << ": expected 'name value'" << endl;
+      return false;
+    }
+
+    if (!set( name.c_str(), value.c_str() )) {
+      cerr << "WorldConfig: (at " << filename << ":" << lineNum << ")" << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+int WorldConfig::numCols() const
+
+{
+  return (WORLD_RIGHT_EDGE - WORLD_LEFT_EDGE) / colSpacing - 1;
+}
+
+
+// Check that the fields fit together: the grid has to fit on the
+// screen with room for the player area below it.
+
+bool WorldConfig::validate()
+
+{
+  bool ok = true;
+
+  if (WORLD_BOTTOM_ROW - rowSpacing <= -1 + rowSpacing) {
+    cerr << "WorldConfig: " << numRows << " rows of spacing " << rowSpacing
+         << " don't leave room for the player ((rows + 1) * rowSpacing must be less than "
+         << (WORLD_TOP_ROW + 1) << ")" << endl;
+    ok = false;
+  }
+
+  if (numCols() < 1) {
+    cerr << "WorldConfig: colSpacing " << colSpacing << " leaves no columns" << endl;
+    ok = false;
+  }
+
+  return ok;
+}
+
+
+void WorldConfig::print( ostream &out )
+
+{
+  Field f[32];
+  int n = fields( f );
+
+  for (int i=0; i<n; i++) {
+    out << f[i].name << " ";
+    switch (f[i].type) {
+    case INT_FIELD:    out << * (int *)    f[i].value; break;
+    case FLOAT_FIELD:  out << * (float *)  f[i].value; break;
+    case DOUBLE_FIELD: out << * (double *) f[i].value; break;
+    }
+    out << endl;
+  }
+}
+
+
+void WorldConfig::printHelp( ostream &out )
+
+{
+  Field f[32];
+  int n = fields( f );
+
+  out << "World settings (for a config file, or -set name=value):" << endl;
+
+  for (int i=0; i<n; i++)
+    out << "  " << f[i].name << string( 24 - strlen( f[i].name ), ' ' )
+        << f[i].help << " [" << f[i].min << "," << f[i].max << "]" << endl;
+
+  out << endl << "Defaults:" << endl;
+  WorldConfig defaults;
+  defaults.print( out );
+}
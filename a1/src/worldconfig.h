@@ -0,0 +1,106 @@
+// worldconfig.h
+//
+// The size of the playing field and the load on the simulation: the
+// number of rows and their spacing, the number of mushrooms, the
+// centipede length, the dart and spider limits, the speeds, the
+// spider timing and the threads.  These used to be #defines in
+// worldDefs.h; they are read from 'worldConfig' at run time so that a
+// different load doesn't need a recompile.  The defaults are the
+// values of the original game.
+//
+// A config file has one setting per line,
+//
+//     name value
+//
+// with '#' starting a comment.  The same settings can be given on the
+// command line as "-set name=value".  Run with "-config help" for the
+// list of names.
+//
+// The config must be set before the World is created and before the
+// renderer builds its geometry, which is sized by the row and column
+// spacing.  A replay only reproduces its game under the config with
+// which it was recorded.
+
+
+#ifndef WORLDCONFIG_H
+#define WORLDCONFIG_H
+
+#include <iostream>
+
+
+class WorldConfig {
+
+  enum FieldType { INT_FIELD, FLOAT_FIELD, DOUBLE_FIELD };
+
+  struct Field {
+    const char *name;
+    FieldType   type;
+    void       *value;
+    double      min, max;
+    const char *help;
+  };
+
+  int fields( Field *f );
+  Field *findField( const char *name, Field *f, int n );
+
+ public:
+
+  // The grid
+
+  int    numRows;
+  double rowSpacing;
+  double colSpacing;
+
+  // Load
+
+  int initNumMushrooms;
+  int maxCentipedeSegments;     // length of the level-1 centipede; one less on each level
+  int maxDartsAtOnce;
+  int maxSpidersAtOnce;
+  int initLivesRemaining;
+
+  // Speeds, in world units per second
+
+  double centipedeInitSpeed;
+  double centipedeSpeedIncPerLevel;
+  double dartSpeed;
+  float  spiderSpeedX;
+  float  spiderSpeedY;
+
+  // Timing, in seconds of simulation time
+
+  float spiderFirstSpawn;       // delay before the first spider
+  float spiderSpawnMin;         // then a spider every [min, min+range] seconds
+  float spiderSpawnRange;
+  double pauseTimeForMessage;
+
+  // Motion
+
+  int analyticMotion;           // 1: a centipede head finds its next turn again after each
+                                //    turn within a tick, so that its path doesn't depend on
+                                //    the step size.  0: as in the original game.
+
+  // Threads
+
+  int threads;                  // threads in the job pool (0: one per core)
+  int parallelSegments;         // update the centipedes on several threads when there are
+                                //    at least this many segments (0: never)
+
+  WorldConfig();                // the defaults
+
+  bool load( const char *filename );
+  bool set( const char *name, const char *value );
+  bool set( const char *assignment ); // "name=value"
+  bool validate();
+
+  void print( std::ostream &out );
+  void printHelp( std::ostream &out );
+
+  int numCols() const;          // derived from colSpacing and the fixed field width
+  int maxLevel() const { return maxCentipedeSegments - 1; }
+};
+
+
+extern WorldConfig worldConfig;
+
+#endif